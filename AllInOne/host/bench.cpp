@@ -0,0 +1,158 @@
+// Host benchmark: times every renderer, the present path and the button state
+// machine on a virtual clock and prints the same CSV as BENCHMARK_MODE on the
+// device. cycles_per_iter is wall time at F_CPU, heap_delta and allocs come
+// from the operator new hook in stubs/host.cpp. With a baseline file it also
+// flags cases that allocate more or got slower than the given tolerance.
+//
+//   make bench                       # compare against bench_baseline.csv
+//   build/bench > bench_baseline.csv # refresh the baseline
+#include "host.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+static const int ITERATIONS = 20000;
+static const int RUNS = 9; // Fastest of RUNS timings per case, the least disturbed one
+
+struct Result
+{
+  double nsPerIter;
+  int64_t heapDelta; // Bytes still held after all runs
+  uint64_t allocs;   // operator new calls per run
+};
+
+template <typename Body>
+static Result timeCase(Body body)
+{
+  double samples[RUNS];
+  int64_t heapBefore = host::heapInUse;
+  uint64_t allocsBefore = host::allocations;
+  for (int run = 0; run < RUNS; run++)
+  {
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < ITERATIONS; n++)
+    {
+      body();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    samples[run] = std::chrono::duration<double, std::nano>(elapsed).count() / ITERATIONS;
+  }
+  std::sort(samples, samples + RUNS);
+  return {samples[0], host::heapInUse - heapBefore, (host::allocations - allocsBefore) / RUNS};
+}
+
+static std::map<std::string, Result> results;
+
+static void report(const std::string &name, const Result &result)
+{
+  results[name] = result;
+  printf("bench,%s,%.0f,%.1f,%lld,%llu\n", name.c_str(), result.nsPerIter * F_CPU / 1e9, result.nsPerIter,
+         static_cast<long long>(result.heapDelta), static_cast<unsigned long long>(result.allocs));
+}
+
+static std::map<std::string, Result> loadBaseline(const char *path)
+{
+  std::map<std::string, Result> baseline;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line))
+  {
+    std::istringstream fields(line);
+    std::string tag, name, cycles, ns, heap, allocs;
+    if (std::getline(fields, tag, ',') && tag == "bench" && std::getline(fields, name, ',') && name != "case" &&
+        std::getline(fields, cycles, ',') && std::getline(fields, ns, ',') && std::getline(fields, heap, ',') &&
+        std::getline(fields, allocs))
+      baseline[name] = {atof(ns.c_str()), atoll(heap.c_str()), strtoull(allocs.c_str(), nullptr, 10)};
+  }
+  return baseline;
+}
+
+int main(int argc, char **argv)
+{
+  srand(1);
+  MaskFrame frame;
+  frame.clear();
+
+  printf("# host bench v2 cpu_mhz=%ld iterations=%d runs=%d\n", F_CPU / 1000000, ITERATIONS, RUNS);
+  printf("bench,case,cycles_per_iter,ns_per_iter,heap_delta,allocs\n");
+
+  for (int i = 0; i < static_cast<int>(Expressions::Type::SIZE); i++)
+  {
+    Expressions::Type type = static_cast<Expressions::Type>(i);
+    if (type == Expressions::Type::NORMAL_EXPRESSION_END)
+      continue;
+
+    host::cycles = 0;
+    auto render = [&]()
+    {
+      host::advanceMillis(BENCHMARK_TICK_MS);
+      Expressions::render(type, frame);
+    };
+    report(std::string("render/") + reinterpret_cast<const char *>(Expressions::getName(type)), timeCase(render));
+  }
+
+  LedController led(NEO_PIN, NEO_NUMPIXEL);
+  led.setBrightness(40);
+  auto correct = [&]()
+  {
+    MaskFrame corrected = led.getCorrectedFrame(frame);
+    frame.left[0][0] = corrected.left[0][0]; // Keep the call from being optimised away
+  };
+  auto present = [&]()
+  {
+    led.present(frame);
+  };
+  report("led/getCorrectedFrame", timeCase(correct));
+  report("led/present", timeCase(present));
+
+  // Button 1 tapped, button 2 held now and then, on a 10 ms virtual frame
+  ButtonHandler buttons(DOUBLE_TAP_TIME, HOLD_TIME);
+  buttons.begin(BUTTON1_PIN, BUTTON2_PIN, BUTTON3_PIN);
+  uint32_t frameIndex = 0;
+  auto scan = [&]()
+  {
+    frameIndex++;
+    host::gpi = 0xFFFFFFFF; // Pull-ups, LOW = pressed
+    if ((frameIndex / 8) % 4 == 0)
+      host::gpi &= ~(1UL << BUTTON1_PIN);
+    if ((frameIndex / 100) % 3 == 0)
+      host::gpi &= ~(1UL << BUTTON2_PIN);
+    buttons.update(BENCHMARK_TICK_MS);
+  };
+  report("input/ButtonHandler::update", timeCase(scan));
+
+  if (argc < 2)
+    return 0;
+
+  double tolerance = argc > 2 ? atof(argv[2]) : 50.0; // Percent, host timings still drift between runs
+  std::map<std::string, Result> baseline = loadBaseline(argv[1]);
+  int regressions = 0;
+  for (const auto &entry : baseline)
+  {
+    auto current = results.find(entry.first);
+    if (current == results.end())
+    {
+      printf("# missing case %s\n", entry.first.c_str());
+      continue;
+    }
+    const Result &was = entry.second;
+    const Result &now = current->second;
+    if (now.allocs > was.allocs || now.heapDelta > was.heapDelta)
+    {
+      printf("# ALLOCATES %s: %llu allocs %lld bytes -> %llu allocs %lld bytes\n", entry.first.c_str(),
+             static_cast<unsigned long long>(was.allocs), static_cast<long long>(was.heapDelta),
+             static_cast<unsigned long long>(now.allocs), static_cast<long long>(now.heapDelta));
+      regressions++;
+    }
+    if (now.nsPerIter > was.nsPerIter * (1.0 + tolerance / 100.0))
+    {
+      printf("# SLOWER %s: %.1f ns -> %.1f ns\n", entry.first.c_str(), was.nsPerIter, now.nsPerIter);
+      regressions++;
+    }
+  }
+  printf("# %d regression(s) against %s (tolerance %.0f%%)\n", regressions, argv[1], tolerance);
+  return regressions == 0 ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+"""RAM/IRAM/flash footprint of main.ino per subsystem and per expression.
+
+Reads the GNU ld map written by the ESP8266 Arduino build (the sketch is
+built with -ffunction-sections -fdata-sections, so each function, static
+and table gets its own input section) and sums section sizes by owner:
+the class for members and their function-local statics, "Expressions/<renderer>"
+for each renderer, and "main" for free functions. PROGMEM tables are named
+after their source line, so they are attributed through the sketch itself.
+
+    python3 footprint.py /tmp/arduino_build_*/main.ino.map
+    python3 footprint.py --csv build.map > footprint.csv
+"""
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+# Output section -> memory it occupies on the ESP8266
+REGIONS = {
+    ".irom0.text": "flash",
+    ".flash.text": "flash",
+    ".flash.rodata": "flash",
+    ".text": "iram",
+    ".iram0.text": "iram",
+    ".data": "ram",
+    ".rodata": "ram",
+    ".bss": "ram",
+    ".noinit": "ram",
+}
+COLUMNS = ("ram", "iram", "flash")
+
+INPUT_SECTION = re.compile(r"^ (\.[^\s]+)(?:\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(.+))?$")
+CONTINUATION = re.compile(r"^\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(.+)$")
+SECTION_PREFIX = re.compile(r"^\.(text|data|rodata|bss|literal|irom0\.text|iram\.text|iram0\.text)\.")
+PROGMEM_SECTION = re.compile(r"^\.irom\.text\..*\.(\d+)\.\d+$")
+
+
+def parse_map(path, sketch_object):
+    """Yields (region, input section name, size) for the sketch's sections."""
+    region = None
+    pending = None
+    in_memory_map = False
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if line.startswith("Linker script and memory map"):
+                in_memory_map = True
+                continue
+            if not in_memory_map:
+                continue
+
+            if line.startswith(".") and not line.startswith(" "):
+                region = REGIONS.get(line.split()[0], None)
+                pending = None
+                continue
+
+            if pending is not None:
+                match = CONTINUATION.match(line)
+                if match:
+                    size, source = int(match.group(2), 16), match.group(3)
+                    if region and size and sketch_object in source:
+                        yield region, pending, size
+                pending = None
+                continue
+
+            match = INPUT_SECTION.match(line)
+            if not match:
+                continue
+            if match.group(2) is None:
+                pending = match.group(1) # Address and size follow on the next line
+            else:
+                size, source = int(match.group(3), 16), match.group(4)
+                if region and size and sketch_object in source:
+                    yield region, match.group(1), size
+
+
+def demangle(names):
+    tool = shutil.which("xtensa-lx106-elf-c++filt") or shutil.which("c++filt")
+    if not tool or not names:
+        return {name: name for name in names}
+    result = subprocess.run([tool], input="\n".join(names), capture_output=True, text=True)
+    return dict(zip(names, result.stdout.splitlines()))
+
+
+def line_owners(sketch_path):
+    """Maps each sketch line to the class/function it sits in."""
+    owners = []
+    current_class = None
+    current_function = None
+    class_def = re.compile(r"^(?:class|struct)\s+(\w+)")
+    namespace_class = re.compile(r"^  class\s+(\w+)")
+    member_def = re.compile(r"^  (?:static\s+)?[\w:<>\*&\s]+?\b(\w+)\s*\(")
+    free_def = re.compile(r"^[\w:<>\*&\s]+?\b(\w+)\s*\([^;]*$")
+    with open(sketch_path, encoding="utf-8") as f:
+        for line in f:
+            if class_def.match(line):
+                current_class, current_function = class_def.match(line).group(1), None
+            elif namespace_class.match(line):
+                current_class, current_function = namespace_class.match(line).group(1), None
+            elif current_class and member_def.match(line) and not line.rstrip().endswith(";"):
+                current_function = member_def.match(line).group(1)
+            elif line.startswith("};"):
+                current_class, current_function = None, None
+            elif current_class is None and free_def.match(line):
+                current_function = free_def.match(line).group(1)
+            owners.append((current_class, current_function))
+    return owners
+
+
+def owner_of(symbol):
+    """Groups a demangled symbol name."""
+    symbol = re.sub(r"^(vtable|typeinfo|typeinfo name|construction vtable) for ", "", symbol)
+    while True:
+        stripped = re.sub(r"<[^<>]*>", "", symbol) # Template arguments, innermost first
+        if stripped == symbol:
+            break
+        symbol = stripped
+    scope = symbol.split("(")[0].split(" ")[-1] # Drop any return type
+    parts = [part for part in scope.split("::") if part]
+    if len(parts) >= 2 and parts[0] == "Core":
+        parts = parts[1:]
+    if len(parts) >= 2:
+        return expression_owner(parts[0], parts[1])
+    return "main"
+
+
+def expression_owner(cls, function):
+    """Renderers get their own row; everything else goes to the class."""
+    if cls == "Expressions" and function and function.startswith("render") and function not in ("render", "renderIndexed"):
+        return "Expressions/" + function[len("render"):]
+    return cls
+
+
+def owner_of_line(owners, line):
+    if line - 1 >= len(owners):
+        return "main"
+    cls, function = owners[line - 1]
+    return expression_owner(cls, function) if cls else "main"
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map", help="linker map file")
+    parser.add_argument("--sketch", default=os.path.join(here, "..", "main.ino"))
+    parser.add_argument("--object", default="main.ino", help="substring naming the sketch object file")
+    parser.add_argument("--csv", action="store_true", help="machine-readable output")
+    args = parser.parse_args()
+
+    sections = list(parse_map(args.map, args.object))
+    if not sections:
+        sys.exit("no sections from an object matching '%s' in %s" % (args.object, args.map))
+
+    mangled = sorted({SECTION_PREFIX.sub("", name) for _, name, _ in sections if SECTION_PREFIX.match(name)})
+    names = demangle(mangled)
+    owners = line_owners(args.sketch)
+
+    totals = {}
+    for region, section, size in sections:
+        progmem = PROGMEM_SECTION.match(section)
+        if progmem:
+            owner = owner_of_line(owners, int(progmem.group(1)))
+        elif SECTION_PREFIX.match(section):
+            owner = owner_of(names.get(SECTION_PREFIX.sub("", section), section))
+        else:
+            owner = "(unnamed)"
+        row = totals.setdefault(owner, dict.fromkeys(COLUMNS, 0))
+        row[region] += size
+
+    rows = sorted(totals.items(), key=lambda item: -sum(item[1].values()))
+    if args.csv:
+        print("owner," + ",".join(COLUMNS))
+        for owner, row in rows:
+            print(owner + "," + ",".join(str(row[c]) for c in COLUMNS))
+        return
+
+    width = max(len(owner) for owner, _ in rows)
+    print("%-*s %8s %8s %8s" % (width, "owner", *COLUMNS))
+    for owner, row in rows:
+        print("%-*s %8d %8d %8d" % (width, owner, *(row[c] for c in COLUMNS)))
+    print("%-*s %8d %8d %8d" % (width, "total", *(sum(r[c] for _, r in rows) for c in COLUMNS)))
+
+
+if __name__ == "__main__":
+    main()
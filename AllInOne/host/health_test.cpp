@@ -0,0 +1,127 @@
+// Runs a HealthMonitor on the virtual clock with the stubbed heap and stack
+// figures and checks that each threshold trips at its limit and not before,
+// and that leaving ERROR clears the code.
+#include "host.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+static Core::ModeManager mode;
+static HealthMonitor health(mode);
+
+// One loop: workUs of work, then the 10 ms idle delay
+static void loopOnce(uint32_t workUs, bool excused = false)
+{
+  health.beginFrame();
+  host::advanceMicros(workUs);
+  if (excused)
+    health.excuseFrame();
+  health.endFrame(10);
+  host::advanceMillis(10);
+}
+
+static void loops(uint32_t count, uint32_t workUs = 1000)
+{
+  for (uint32_t i = 0; i < count; i++)
+    loopOnce(workUs);
+}
+
+// Leaves ERROR the way a hold-release and tap do and lets a frame see it
+static void recover()
+{
+  mode.setMode(Core::Mode::ACTIVE);
+  loopOnce(1000);
+}
+
+static void resetStubs()
+{
+  host::freeHeap = 40000;
+  host::maxFreeBlock = 30000;
+  host::freeContStack = 3000;
+}
+
+int main()
+{
+  mode.setMode(Core::Mode::ACTIVE);
+  loops(200);
+  check(health.getError() == HealthError::None && mode.isActive(), "healthy loop stays ACTIVE");
+
+  // Overruns trip only after HEALTH_MAX_CONSECUTIVE_OVERRUNS in a row
+  loops(HEALTH_MAX_CONSECUTIVE_OVERRUNS - 1, HEALTH_FRAME_BUDGET_US + 1);
+  loopOnce(1000);
+  loops(HEALTH_MAX_CONSECUTIVE_OVERRUNS - 1, HEALTH_FRAME_BUDGET_US + 1);
+  check(health.getError() == HealthError::None, "interrupted overruns do not trip");
+  loops(1, HEALTH_FRAME_BUDGET_US);
+  check(health.getError() == HealthError::None, "work exactly at the budget is not an overrun");
+  for (int i = 0; i < 2 * HEALTH_MAX_CONSECUTIVE_OVERRUNS; i++)
+    loopOnce(HEALTH_FRAME_BUDGET_US * 5, true);
+  check(health.getError() == HealthError::None, "excused frames do not count as overruns");
+  loops(HEALTH_MAX_CONSECUTIVE_OVERRUNS, HEALTH_FRAME_BUDGET_US + 1);
+  check(health.getError() == HealthError::LoopOverrun && mode.isError(), "consecutive overruns trip ERROR");
+
+  recover();
+  check(health.getError() == HealthError::None, "leaving ERROR clears the code");
+
+  // Heap, block and stack are sampled every HEALTH_CHECK_INTERVAL_MS at the limit
+  host::freeHeap = HEALTH_MIN_FREE_HEAP;
+  host::maxFreeBlock = HEALTH_MIN_FREE_BLOCK;
+  host::freeContStack = HEALTH_MIN_FREE_STACK;
+  loops(2 * HEALTH_CHECK_INTERVAL_MS / 10);
+  check(health.getError() == HealthError::None, "resources exactly at their limits do not trip");
+
+  host::freeHeap = HEALTH_MIN_FREE_HEAP - 1;
+  loops(HEALTH_CHECK_INTERVAL_MS / 10 + 1);
+  check(health.getError() == HealthError::LowHeap && mode.isError(), "low heap trips");
+  resetStubs();
+  recover();
+
+  host::maxFreeBlock = HEALTH_MIN_FREE_BLOCK - 1;
+  loops(HEALTH_CHECK_INTERVAL_MS / 10 + 1);
+  check(health.getError() == HealthError::HeapFragmentation, "small largest block trips");
+  resetStubs();
+  recover();
+
+  host::freeContStack = HEALTH_MIN_FREE_STACK - 1;
+  loops(HEALTH_CHECK_INTERVAL_MS / 10 + 1);
+  check(health.getError() == HealthError::StackOverrun, "low stack trips");
+  resetStubs();
+  recover();
+
+  // A fault that is still there trips again after recovering
+  host::freeHeap = HEALTH_MIN_FREE_HEAP - 1;
+  loops(HEALTH_CHECK_INTERVAL_MS / 10 + 1);
+  recover();
+  loops(HEALTH_CHECK_INTERVAL_MS / 10 + 1);
+  check(health.getError() == HealthError::LowHeap && mode.isError(), "persistent fault trips again");
+  resetStubs();
+  recover();
+
+  // Watchdog margin: one loop gap closer than HEALTH_MIN_WDT_MARGIN_MS to the timeout
+  host::advanceMillis(HEALTH_WDT_TIMEOUT_MS - HEALTH_MIN_WDT_MARGIN_MS - 20);
+  loops(HEALTH_CHECK_INTERVAL_MS / 10 + 1);
+  check(health.getError() == HealthError::None, "loop gap inside the margin does not trip");
+  host::advanceMillis(HEALTH_WDT_TIMEOUT_MS - HEALTH_MIN_WDT_MARGIN_MS + 10);
+  loops(HEALTH_CHECK_INTERVAL_MS / 10 + 1);
+  check(health.getError() == HealthError::WatchdogMargin, "long loop gap trips the watchdog margin");
+  recover();
+
+  // While OFF the code is kept for the stats but the mode is left alone
+  mode.setMode(Core::Mode::OFF);
+  host::freeHeap = HEALTH_MIN_FREE_HEAP - 1;
+  loops(HEALTH_CHECK_INTERVAL_MS / 10 + 1);
+  check(health.getError() == HealthError::LowHeap && mode.isOff(), "fault while OFF stays OFF");
+  resetStubs();
+  loops(10);
+  check(health.getError() == HealthError::LowHeap, "code kept while never shown");
+
+  printf("%s\n", failures == 0 ? "health_test ok" : "health_test FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,7 @@
+// Pulls the sketch into a host program. The Makefile generates the function
+// prototypes that the Arduino builder would otherwise add.
+#pragma once
+
+#include <Arduino.h>
+#include "prototypes.h"
+#include "../main.ino"
@@ -0,0 +1,134 @@
+// Plays imu_trace.csv through HeadMotion on the mock Wire bus and checks the
+// gaze and jerk reaction at fixed points of the trace, then pulls the sensor
+// off the bus. Trace rows are raw accel and gyro counts every 10 ms, as read
+// from the MPU6050 registers.
+#define IMU_MODE 1
+#include "host.h"
+
+struct TraceRow
+{
+  uint32_t ms;
+  int16_t accel[3];
+  int16_t gyro[3];
+};
+
+// Trace time, expected gaze and whether the jerk reaction should be showing
+struct Checkpoint
+{
+  uint32_t ms;
+  int8_t gaze;
+  bool surprised;
+};
+
+static const Checkpoint CHECKPOINTS[] = {
+    {900, -1, false},  // Still calibrating
+    {2400, 2, false},  // Holding a 30 degree nod
+    {3900, -1, false}, // Back to level
+    {4400, 0, false},  // Just turned left
+    {7700, -1, false}, // Yaw has leaked back to centre
+    {7850, -1, true},  // Jerk
+};
+
+static TraceRow current;
+static int failures = 0;
+
+static void check(bool ok, const char *what, uint32_t ms)
+{
+  if (!ok)
+  {
+    printf("FAIL %s at %u ms\n", what, ms);
+    failures++;
+  }
+}
+
+static void putAxes(uint8_t reg, const int16_t *axes)
+{
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    Wire.registers[reg + i * 2] = static_cast<uint16_t>(axes[i]) >> 8;
+    Wire.registers[reg + i * 2 + 1] = axes[i] & 0xFF;
+  }
+}
+
+// Serves the current trace row to whichever block the sketch reads
+static void onRead(uint8_t reg, uint8_t count)
+{
+  if (reg == 0x3B)
+    putAxes(reg, current.accel);
+  else if (reg == 0x43)
+    putAxes(reg, current.gyro);
+}
+
+int main(int argc, char **argv)
+{
+  const char *path = argc > 1 ? argv[1] : "imu_trace.csv";
+  FILE *trace = fopen(path, "r");
+  if (trace == nullptr)
+  {
+    printf("FAIL cannot open %s\n", path);
+    return 1;
+  }
+
+  Wire.onRead = onRead;
+  setup();
+  check(headMotion.isConnected(), "sensor found", 0);
+
+  char line[128];
+  size_t nextCheckpoint = 0;
+  uint32_t rows = 0;
+  while (fgets(line, sizeof(line), trace) != nullptr)
+  {
+    int v[7];
+    if (line[0] == '#' || sscanf(line, "%d,%d,%d,%d,%d,%d,%d", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6]) != 7)
+      continue;
+
+    current.ms = v[0];
+    for (uint8_t i = 0; i < 3; i++)
+    {
+      current.accel[i] = v[1 + i];
+      current.gyro[i] = v[4 + i];
+    }
+
+    // One bus transaction per loop, accel and gyro on alternate loops
+    for (uint8_t half = 0; half < 2; half++)
+    {
+      uint32_t before = Wire.transactions;
+      host::advanceMillis(5);
+      updateHeadMotion(5);
+      check(Wire.transactions - before == 1, "one transaction per update", current.ms);
+    }
+    rows++;
+
+    while (nextCheckpoint < sizeof(CHECKPOINTS) / sizeof(CHECKPOINTS[0]) &&
+           CHECKPOINTS[nextCheckpoint].ms == current.ms)
+    {
+      const Checkpoint &point = CHECKPOINTS[nextCheckpoint++];
+      if (headMotion.getGazeDirection() != point.gaze)
+        printf("  gaze=%d pitch=%d yaw=%d\n", headMotion.getGazeDirection(), headMotion.getPitch(), headMotion.getYaw());
+      check(headMotion.getGazeDirection() == point.gaze, "gaze", point.ms);
+      bool surprised = expressionManager.getCurrentExpression() == Expressions::Type::Surprised;
+      check(surprised == point.surprised, "jerk reaction", point.ms);
+    }
+  }
+  fclose(trace);
+  check(rows > 0 && nextCheckpoint == sizeof(CHECKPOINTS) / sizeof(CHECKPOINTS[0]), "trace covers every checkpoint", rows * 10);
+
+  // Turn the head so there is a gaze to lose, then drop the sensor
+  for (uint8_t i = 0; i < 40; i++)
+  {
+    current.gyro[2] = 120 * 131;
+    updateHeadMotion(5);
+  }
+  check(headMotion.getGazeDirection() == 0, "gaze before the sensor drops", current.ms);
+  Wire.present = false;
+  for (uint8_t i = 0; i < IMU_MAX_BUS_ERRORS; i++)
+  {
+    updateHeadMotion(5);
+  }
+  check(!headMotion.isConnected(), "sensor given up after IMU_MAX_BUS_ERRORS", current.ms);
+  check(headMotion.getGazeDirection() == -1, "no gaze without the sensor", current.ms);
+
+  headMotion.printStats();
+  printf("%s\n", failures == 0 ? "imu_test ok" : "imu_test FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+// Plays scripted button gestures through loop() with LATENCY_MODE on and
+// checks each gesture's edge-to-photon time against its budget. The buttons
+// are driven through the GPIO levels that loop() hands to
+// ButtonHandler::update(rawMask, deltaTime), and every level change raises the
+// edge interrupt like the real pins do. The NeoPixel stub takes the strip's
+// wire time, so change-to-photon includes clocking the pixels out.
+//
+// Budgets are fixed requirements, not derived from the timing constants: a
+// performer expects a tap to show within 450 ms (it has to wait out the double
+// tap window), a double tap within 300 ms and a release within 80 ms. A state
+// change must reach the LEDs within 2 ms, in the same frame.
+#define LATENCY_MODE 1
+#define LOG_BINARY 0 // Readable log lines between the results
+#include "host.h"
+
+#define TAP_BUDGET_MS 450
+#define DOUBLE_TAP_BUDGET_MS 300
+#define RELEASE_BUDGET_MS 80
+#define CHANGE_TO_PHOTON_BUDGET_US 2000
+
+#define B1 0x01
+#define B2 0x02
+
+// Holds the buttons in pressed for ms
+struct Step
+{
+  uint8_t pressed;
+  uint16_t ms;
+};
+
+struct Gesture
+{
+  const char *name;
+  Step steps[4];
+  uint32_t budgetMs; // Edge to photon, from the first edge that starts the gesture
+};
+
+static const Gesture GESTURES[] = {
+    {"b1 tap: next expression",
+     {{B1, 60}, {0, 600}},
+     TAP_BUDGET_MS},
+    {"b2 double tap: quick switch",
+     {{B2, 60}, {0, 80}, {B2, 60}, {0, 600}},
+     DOUBLE_TAP_BUDGET_MS}, // Timed from the first press
+    {"b2 held + b1 tap: brightness",
+     {{B2, 800}, {B2 | B1, 60}, {B2, 600}, {0, 100}},
+     TAP_BUDGET_MS}, // Timed from the b1 press, the b2 hold shows nothing
+    {"b1 hold and release: off",
+     {{B1, 900}, {0, 100}},
+     RELEASE_BUDGET_MS}, // Timed from the release, the hold shows nothing
+    {"b1 tap: wake up",
+     {{B1, 60}, {0, 600}},
+     TAP_BUDGET_MS},
+};
+
+static uint8_t pressed = 0;
+static int failures = 0;
+
+static void setButtons(uint8_t mask)
+{
+  if (mask == pressed)
+    return;
+
+  pressed = mask;
+  host::gpi |= (1UL << BUTTON1_PIN) | (1UL << BUTTON2_PIN); // Pull-ups, LOW = pressed
+  if (mask & B1)
+    host::gpi &= ~(1UL << BUTTON1_PIN);
+  if (mask & B2)
+    host::gpi &= ~(1UL << BUTTON2_PIN);
+  onButtonEdge();
+}
+
+static void run(uint32_t ms)
+{
+  uint64_t end = host::nowMicros() + ms * 1000ULL;
+  while (host::nowMicros() < end)
+    loop();
+}
+
+int main()
+{
+  setButtons(0);
+  setup();
+  run(500); // Past the double tap window after boot
+
+  for (const Gesture &gesture : GESTURES)
+  {
+    latencyProbe = LatencyProbe();
+    uint32_t signatureBefore = getVisibleStateSignature();
+
+    for (const Step &step : gesture.steps)
+    {
+      if (step.ms == 0)
+        break;
+      setButtons(step.pressed);
+      run(step.ms);
+    }
+
+    uint32_t count = latencyProbe.getCount(LatencyProbe::EdgeToPhoton);
+    uint32_t edgeToPhotonMs = latencyProbe.getMaxUs(LatencyProbe::EdgeToPhoton) / 1000;
+    uint32_t changeToPhotonUs = latencyProbe.getMaxUs(LatencyProbe::ChangeToPhoton);
+    bool ok = getVisibleStateSignature() != signatureBefore && count == 1 &&
+              edgeToPhotonMs <= gesture.budgetMs && changeToPhotonUs <= CHANGE_TO_PHOTON_BUDGET_US;
+    printf("%-4s %-30s edge>photon=%u ms budget=%u ms change>photon=%u us samples=%u\n",
+           ok ? "ok" : "FAIL", gesture.name, edgeToPhotonMs, gesture.budgetMs, changeToPhotonUs, count);
+    if (!ok)
+      failures++;
+  }
+
+  latencyProbe.printStats();
+  printf("%s\n", failures == 0 ? "latency_test ok" : "latency_test FAILED");
+  return failures == 0 ? 0 : 1;
+}
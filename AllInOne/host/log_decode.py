@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""Decode the binary log stream from main.ino (LOG_BINARY 1).
+
+Each record is LOG_SYNC_BYTE (0x7E) followed by the 8-byte little-endian
+LogRecord: uint32 timestamp, uint8 event, uint8 arg0, uint16 arg1. Anything
+between records (printStats output and the like) is passed through as text.
+Event names are read from the LogEvent enum in the sketch so they can't drift.
+When the sketch also has an enum named after the event (HealthStat,
+HealthError), arg0 is shown by that enum's member name.
+
+    python3 log_decode.py capture.bin
+    cat /dev/ttyUSB0 | python3 log_decode.py
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+
+SYNC = 0x7E
+RECORD = struct.Struct("<IBBH")
+
+
+def enum_members(source, enum):
+    match = re.search(r"enum class " + enum + r"\s*:\s*uint8_t\s*\{(.*?)\};", source, re.S)
+    if not match:
+        return None
+    body = re.sub(r"//[^\n]*", "", match.group(1))
+    names = [name.strip() for name in body.split(",") if name.strip()]
+    return [name for name in names if name != "COUNT"]
+
+
+def load_event_names(sketch_path):
+    with open(sketch_path, encoding="utf-8") as f:
+        source = f.read()
+    names = enum_members(source, "LogEvent")
+    if names is None:
+        sys.exit("LogEvent enum not found in " + sketch_path)
+    arg_names = {name: enum_members(source, name) for name in names}
+    return names, arg_names
+
+
+def decode(data, names, arg_names, out):
+    i = 0
+    text = bytearray()
+    while i < len(data):
+        byte = data[i]
+        if byte == SYNC and i + 1 + RECORD.size <= len(data):
+            timestamp, event, arg0, arg1 = RECORD.unpack_from(data, i + 1)
+            if event < len(names):
+                if text:
+                    out.write(text.decode("ascii", "replace"))
+                    text.clear()
+                members = arg_names.get(names[event])
+                arg = members[arg0] if members and arg0 < len(members) else arg0
+                out.write("[%d] %s %s %d\n" % (timestamp, names[event], arg, arg1))
+                i += 1 + RECORD.size
+                continue
+        text.append(byte)
+        i += 1
+    if text:
+        out.write(text.decode("ascii", "replace"))
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", nargs="?", help="raw serial capture, stdin if omitted")
+    parser.add_argument("--sketch", default=os.path.join(here, "..", "main.ino"))
+    args = parser.parse_args()
+
+    names, arg_names = load_event_names(args.sketch)
+    if args.capture:
+        with open(args.capture, "rb") as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+    decode(data, names, arg_names, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,23 @@
+// Pushes one record of every LogEvent with text in between and drains them to
+// stdout as the binary stream, then the health stats, whose arg0 the decoder
+// names by HealthStat. 'make test' pipes this through log_decode.py
+// and compares with log_expected.txt.
+#include "host.h"
+
+int main()
+{
+  for (uint8_t event = 0; event < static_cast<uint8_t>(LogEvent::COUNT); event++)
+  {
+    host::advanceMillis(250);
+    logger.push(static_cast<LogEvent>(event), event + 1, 1000 + event);
+  }
+  logger.drain();
+
+  Serial.println(F("Health: ok"));
+  logger.push(LogEvent::ButtonTap, 2, 0x7E7E); // Sync bytes inside a record
+  logger.drain();
+
+  healthMonitor.logStats();
+  logger.drain();
+  return 0;
+}
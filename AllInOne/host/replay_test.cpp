@@ -0,0 +1,144 @@
+// Records a few gestures with INPUT_TRACE_MODE on, then replays the trace from
+// two different live states. The replay report must be the same both times and
+// the live state, the live button handler and stored settings must be left
+// exactly as they were, with nothing logged for the replayed events.
+#define INPUT_TRACE_MODE 1
+#define LOG_BINARY 0 // Readable log lines around the replay report
+#include "host.h"
+
+#include <string>
+#include <unistd.h>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+static void setButtons(uint8_t mask)
+{
+  host::gpi |= (1UL << BUTTON1_PIN) | (1UL << BUTTON2_PIN);
+  if (mask & 0x01)
+    host::gpi &= ~(1UL << BUTTON1_PIN);
+  if (mask & 0x02)
+    host::gpi &= ~(1UL << BUTTON2_PIN);
+}
+
+static void run(uint32_t ms)
+{
+  uint64_t end = host::nowMicros() + ms * 1000ULL;
+  while (host::nowMicros() < end)
+    loop();
+}
+
+// Runs body and returns what it printed
+template <typename Body>
+static std::string captureOutput(Body body)
+{
+  fflush(stdout);
+  int savedStdout = dup(1);
+  FILE *capture = tmpfile();
+  dup2(fileno(capture), 1);
+
+  body();
+
+  fflush(stdout);
+  dup2(savedStdout, 1);
+  close(savedStdout);
+
+  std::string output;
+  rewind(capture);
+  int c;
+  while ((c = fgetc(capture)) != EOF)
+    output += static_cast<char>(c);
+  fclose(capture);
+  fputs(output.c_str(), stdout);
+  return output;
+}
+
+// Runs the replay and returns what it printed, failing if it left log records
+static std::string replay()
+{
+  std::string output = captureOutput(replayInputTrace);
+  check(captureOutput([]() { logger.drain(); }).empty(), "replay logs nothing");
+  return output;
+}
+
+static uint32_t liveSignature()
+{
+  return static_cast<uint32_t>(expressionManager.getCurrentExpression()) |
+         (static_cast<uint32_t>(expressionManager.getQuickExpression()) << 8) |
+         (static_cast<uint32_t>(modeManager.getMode()) << 16) |
+         (static_cast<uint32_t>(ledController.getBrightness()) << 24);
+}
+
+int main()
+{
+  setButtons(0);
+  setup();
+  run(100);
+
+  // b1 tap, b2 held + b1 tap (brightness), b2 double tap
+  inputTrace.start();
+  setButtons(0x01);
+  run(60);
+  setButtons(0);
+  run(500);
+  setButtons(0x02);
+  run(800);
+  setButtons(0x03);
+  run(60);
+  setButtons(0x02);
+  run(500);
+  setButtons(0);
+  run(100);
+  setButtons(0x02);
+  run(60);
+  setButtons(0);
+  run(80);
+  setButtons(0x02);
+  run(60);
+  setButtons(0);
+  run(500);
+  inputTrace.stop();
+  check(inputTrace.getLength() > 0, "trace recorded");
+
+  uint32_t before = liveSignature();
+  std::string first = replay();
+  check(liveSignature() == before, "live state restored after replay");
+
+  // A replay in the middle of a live hold leaves that hold alone
+  setButtons(0x02);
+  run(800);
+  check(buttonHandler.isButtonHeld(BUTTON2_PIN), "live hold before replay");
+  replay();
+  check(buttonHandler.isButtonHeld(BUTTON2_PIN), "live hold kept across replay");
+  setButtons(0);
+  run(500);
+
+  // A different live state must not change the replay
+  expressionManager.setExpression(Expressions::Type::Angry);
+  ledController.setBrightness(80);
+  sequencer.start(SHOWS[0]);
+  before = liveSignature();
+  std::string second = replay();
+  check(liveSignature() == before, "live state restored after second replay");
+  check(sequencer.isRunning(), "live show still running");
+  check(first == second, "replay independent of the live state");
+  check(first.find("# replay done") != std::string::npos, "replay reported");
+
+  // What settings stored must be the live state, not where a replay ended
+  sequencer.stop();
+  run(SETTINGS_SAVE_DELAY + 100);
+  before = liveSignature();
+  Settings stored(ledController, modeManager, expressionManager);
+  check(stored.load() && liveSignature() == before, "stored settings match the live state");
+
+  printf("%s\n", failures == 0 ? "replay_test ok" : "replay_test FAILED");
+  return failures == 0 ? 0 : 1;
+}
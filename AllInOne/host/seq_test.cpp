@@ -0,0 +1,138 @@
+// Runs cue lists through updateSequencer() on the virtual clock and checks
+// that shows end where they should, with their last fade completed, that the
+// sequencer then goes idle and hands the output back to the user's brightness,
+// and that a Transition cue crossfades between expressions.
+#include "host.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+static uint8_t showLevel = 0; // Output brightness on the last frame the show was still busy
+
+// Feeds frames of stepMs until the sequencer is idle or limitMs passes
+static uint32_t play(uint32_t stepMs, uint32_t limitMs)
+{
+  uint32_t elapsed = 0;
+  while (elapsed < limitMs)
+  {
+    updateSequencer(stepMs);
+    elapsed += stepMs;
+    if (sequencer.isIdle())
+      break;
+    showLevel = ledController.getOutputBrightness();
+  }
+  return elapsed;
+}
+
+int main()
+{
+  modeManager.setMode(Core::Mode::ACTIVE);
+  ledController.setBrightness(10);
+  check(sequencer.start(SHOWS[0]), "demo show starts");
+  play(10, 20000);
+  check(sequencer.isIdle(), "demo show ends and goes idle");
+  check(expressionManager.getCurrentExpression() == Expressions::Type::Neutral, "demo show ends on Neutral");
+  check(showLevel == 40, "demo show ends at brightness 40");
+  check(ledController.getBrightness() == 10 && ledController.getOutputBrightness() == 10,
+        "user brightness untouched and back on the output");
+
+  // Last cue is a fade that shares its time with End
+  static const Cue FADE_AT_END[] PROGMEM = {
+      CUE_EXPRESSION(0, Happy),
+      CUE_BRIGHTNESS(100, 2, 500),
+      CUE_END(100)};
+  ledController.setBrightness(30);
+  check(sequencer.start({FADE_AT_END, 3}), "fade-at-end show starts");
+  play(10, 50);
+  check(ledController.getOutputBrightness() == 30, "fade has not started yet");
+  play(10, 300);
+  uint8_t midway = ledController.getOutputBrightness();
+  check(!sequencer.isRunning() && !sequencer.isIdle() && midway < 30 && midway > 2, "fade runs after End");
+  play(10, 1000);
+  check(showLevel == 2, "fade completes after End");
+  check(sequencer.isIdle() && ledController.getOutputBrightness() == 30, "idle once the fade after End is done");
+
+  // Once idle, a late ramp is ignored
+  sequencer.startRamp(30, 1, 100);
+  play(10, 200);
+  check(ledController.getOutputBrightness() == 30, "no ramp once idle");
+
+  // Last cue is a fade with no End
+  static const Cue FADE_LAST[] PROGMEM = {
+      CUE_BRIGHTNESS(0, 20, 200)};
+  check(sequencer.start({FADE_LAST, 1}), "fade-last show starts");
+  play(10, 1000);
+  check(showLevel == 20, "fade completes as the last cue");
+  check(ledController.getBrightness() == 30, "show fades leave the user brightness alone");
+
+  // A stopped show leaves brightness alone
+  check(sequencer.start({FADE_LAST, 1}), "show restarts");
+  sequencer.stop();
+  ledController.setBrightness(5);
+  sequencer.startRamp(5, 40, 100);
+  play(10, 200);
+  check(ledController.getOutputBrightness() == 5, "no ramp after stop");
+
+  // Transition switches the expression at once and crossfades the output
+  static const Cue TRANSITION[] PROGMEM = {
+      CUE_EXPRESSION(0, Happy),
+      CUE_TRANSITION(100, Sad, 400),
+      CUE_END(100)};
+  check(sequencer.start({TRANSITION, 3}), "transition show starts");
+  play(10, 50);
+  expressionManager.updateFrame();
+  MaskFrame happy = frame;
+  play(10, 60);
+  uint8_t mix;
+  check(expressionManager.getCurrentExpression() == Expressions::Type::Sad, "transition sets the expression");
+  check(sequencer.getTransitionMix(mix) && mix < 64, "crossfade starts from the old frame");
+  play(10, 200);
+  check(sequencer.getTransitionMix(mix) && mix > 64 && mix < 192, "crossfade halfway");
+  check(memcmp(&transitionFrom, &happy, sizeof(MaskFrame)) == 0, "crossfade starts from the last shown frame");
+  play(10, 1000);
+  check(!sequencer.getTransitionMix(mix) && sequencer.isIdle(), "crossfade completes after End");
+
+  // Blend end points and midpoint
+  MaskFrame from, to;
+  from.clear();
+  to.clear();
+  from.left[0][0] = {200, 0, 100};
+  to.left[0][0] = {0, 200, 100};
+  MaskFrame blended = to;
+  blended.blendFrom(from, 0);
+  check(blended.left[0][0].r == 200 && blended.left[0][0].g == 0, "mix 0 shows the old frame");
+  blended = to;
+  blended.blendFrom(from, 255);
+  check(blended.left[0][0].r == 0 && blended.left[0][0].g == 200, "mix 255 shows the new frame");
+  blended = to;
+  blended.blendFrom(from, 128);
+  check(blended.left[0][0].r == 100 && blended.left[0][0].g == 100 && blended.left[0][0].b == 100, "mix 128 is halfway");
+
+  // Malformed lists are rejected
+  static const Cue BACKWARDS[] PROGMEM = {
+      CUE_EXPRESSION(100, Happy),
+      CUE_EXPRESSION(50, Sad)};
+  check(!sequencer.start({BACKWARDS, 2}), "rejects decreasing times");
+  static const Cue UNKNOWN_LABEL[] PROGMEM = {
+      CUE_LOOP(100, 3, 0)};
+  check(!sequencer.start({UNKNOWN_LABEL, 1}), "rejects loop without label");
+  static const Cue ZERO_LENGTH_LOOP[] PROGMEM = {
+      CUE_LABEL(100, 0),
+      CUE_EXPRESSION(100, Happy),
+      CUE_LOOP(100, 0, 0)};
+  check(!sequencer.start({ZERO_LENGTH_LOOP, 3}), "rejects zero-length loop");
+  static const Cue BAD_TRANSITION[] PROGMEM = {
+      CUE_TRANSITION(0, NORMAL_EXPRESSION_END, 100)};
+  check(!sequencer.start({BAD_TRANSITION, 1}), "rejects transition to a non-expression");
+
+  printf("%s\n", failures == 0 ? "seq_test ok" : "seq_test FAILED");
+  return failures == 0 ? 0 : 1;
+}
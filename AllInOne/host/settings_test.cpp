@@ -0,0 +1,154 @@
+// Drives Settings against the emulated flash sector: records are loaded by
+// sequence number and CRC, a full sector is erased at an idle point, the
+// newest record survives the erase and a scrolling message is never stored.
+#include "host.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+#define RECORD_SIZE 16 // Settings::SettingsRecord
+#define RECORDS_PER_SECTOR (SETTINGS_SECTOR_SIZE / RECORD_SIZE)
+
+// Same CRC-32 as Settings::computeCrc, over everything but the crc field
+static uint32_t crc32(const uint8_t *data, size_t size)
+{
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < size; i++)
+  {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static void putRecord(uint16_t slot, uint8_t brightness, uint8_t expression, uint32_t sequence, bool goodCrc = true)
+{
+  uint8_t *p = &host::flash[slot * RECORD_SIZE];
+  uint8_t record[RECORD_SIZE] = {SETTINGS_MAGIC, brightness, expression, 0, static_cast<uint8_t>(Core::Mode::ACTIVE), 0, 0, 0};
+  memcpy(&record[8], &sequence, sizeof(sequence));
+  uint32_t crc = crc32(record, RECORD_SIZE - 4) ^ (goodCrc ? 0 : 1);
+  memcpy(&record[12], &crc, sizeof(crc));
+  memcpy(p, record, RECORD_SIZE);
+}
+
+static void eraseFlash()
+{
+  memset(host::flash, 0xFF, sizeof(host::flash));
+  host::flashErased = true;
+  host::flashErases = 0;
+}
+
+static bool isBlank(uint16_t slot)
+{
+  for (int i = 0; i < RECORD_SIZE; i++)
+  {
+    if (host::flash[slot * RECORD_SIZE + i] != 0xFF)
+      return false;
+  }
+  return true;
+}
+
+static void resetState()
+{
+  ledController.setBrightness(5);
+  expressionManager.setExpression(Expressions::Type::Neutral);
+  modeManager.setMode(Core::Mode::ACTIVE);
+}
+
+// Calls update() for ms in 10 ms frames, returns how many calls blocked on an erase
+static int run(Settings &store, uint32_t ms)
+{
+  int blocked = 0;
+  for (uint32_t t = 0; t < ms; t += 10)
+  {
+    if (store.update(10))
+      blocked++;
+  }
+  return blocked;
+}
+
+int main()
+{
+  // Blank sector: defaults stay
+  eraseFlash();
+  resetState();
+  check(!settings.load(), "blank sector loads nothing");
+  check(ledController.getBrightness() == 5, "blank sector keeps the default brightness");
+
+  // A corrupt sector: bad CRC and out-of-range fields are rejected
+  putRecord(0, 80, static_cast<uint8_t>(Expressions::Type::Happy), 1, false);
+  check(!settings.load(), "record with a bad CRC rejected");
+  check(ledController.getBrightness() == 5, "bad CRC keeps the defaults");
+  eraseFlash();
+  putRecord(0, 80, static_cast<uint8_t>(Expressions::Type::SIZE), 1);
+  check(!settings.load(), "record with an unknown expression rejected");
+  check(expressionManager.getCurrentExpression() == Expressions::Type::Neutral, "invalid record keeps the defaults");
+
+  // Newest sequence number wins, not the last slot
+  eraseFlash();
+  putRecord(0, 10, static_cast<uint8_t>(Expressions::Type::Happy), 7);
+  putRecord(1, 20, static_cast<uint8_t>(Expressions::Type::Sad), 9);
+  putRecord(2, 30, static_cast<uint8_t>(Expressions::Type::Angry), 8);
+  putRecord(3, 40, static_cast<uint8_t>(Expressions::Type::Wink), 10, false);
+  check(settings.load(), "sector with valid records loads");
+  check(ledController.getBrightness() == 20 && expressionManager.getCurrentExpression() == Expressions::Type::Sad,
+        "newest valid sequence number wins");
+
+  // Saves append after the newest record
+  ledController.setBrightness(21);
+  check(run(settings, SETTINGS_SAVE_DELAY + 100) == 0, "save does not erase");
+  check(!isBlank(4), "save appended after the last used slot");
+
+  // Fill the sector. The write into the last slot must not erase in the same
+  // update(), the erase comes once the state has stayed saved for a while.
+  eraseFlash();
+  resetState();
+  settings.load();
+  for (int i = 0; i < RECORDS_PER_SECTOR; i++)
+  {
+    ledController.setBrightness(10 + i % 100);
+    check(run(settings, SETTINGS_SAVE_DELAY + 100) == 0, "no erase while the sector fills");
+  }
+  check(!isBlank(RECORDS_PER_SECTOR - 1) && host::flashErases == 0, "sector filled without erasing");
+  uint8_t last = ledController.getBrightness();
+
+  check(run(settings, SETTINGS_SAVE_DELAY + 100) == 1, "full sector erased once at an idle point");
+  check(host::flashErases == 1, "one erase per sector");
+  check(!isBlank(0) && isBlank(1), "newest record written back after the erase");
+
+  // A reset right after the erase finds the newest settings
+  resetState();
+  check(settings.load() && ledController.getBrightness() == last, "newest record survives the erase");
+
+  // And the log continues after it
+  ledController.setBrightness(99);
+  check(run(settings, SETTINGS_SAVE_DELAY + 100) == 0 && !isBlank(1), "save after the erase goes to the next slot");
+  resetState();
+  check(settings.load() && ledController.getBrightness() == 99, "save after the erase loads");
+
+  // A message that outlasts SETTINGS_SAVE_DELAY is not stored as the expression
+  expressionManager.setExpression(Expressions::Type::Happy);
+  run(settings, SETTINGS_SAVE_DELAY + 100);
+  TextScroller &scroller = Expressions::getTextScroller();
+  scroller.clear();
+  scroller.append("A MESSAGE LONGER THAN THE SAVE DELAY");
+  check(scroller.getDuration() > SETTINGS_SAVE_DELAY, "message outlasts the save delay");
+  showMessage();
+  run(settings, SETTINGS_SAVE_DELAY + 100);
+  check(expressionManager.getCurrentExpression() == Expressions::Type::Text, "message still showing");
+  resetState();
+  check(settings.load() && expressionManager.getCurrentExpression() == Expressions::Type::Happy,
+        "expression under the message stored");
+
+  printf("%s\n", failures == 0 ? "settings_test ok" : "settings_test FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+// Host stand-in for Adafruit_NeoPixel: keeps the brightness-scaled GRB buffer
+// the real library keeps. show() counts frames and moves the virtual clock by
+// the time the real one spends clocking the pixels out.
+#pragma once
+
+#include <Arduino.h>
+
+#define NEO_GRB 0x52
+#define NEO_KHZ800 0x0000
+
+class Adafruit_NeoPixel
+{
+public:
+  Adafruit_NeoPixel(uint16_t count, int16_t, uint16_t) : count(count), pixels(new uint8_t[count * 3]()) {}
+  ~Adafruit_NeoPixel() { delete[] pixels; }
+
+  void begin() {}
+  // 24 bits at 800 kHz is 30 us per pixel, plus the 50 us latch
+  void show()
+  {
+    showCount++;
+    host::advanceMicros(count * 30 + 50);
+  }
+
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b)
+  {
+    return (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b;
+  }
+
+  void setPixelColor(uint16_t index, uint32_t color)
+  {
+    if (index >= count)
+      return;
+
+    uint8_t r = color >> 16;
+    uint8_t g = color >> 8;
+    uint8_t b = color;
+    if (brightness != 0)
+    {
+      r = (r * brightness) >> 8;
+      g = (g * brightness) >> 8;
+      b = (b * brightness) >> 8;
+    }
+    uint8_t *p = &pixels[index * 3];
+    p[0] = g;
+    p[1] = r;
+    p[2] = b;
+  }
+
+  // Stored as level + 1 like the library, so 255 means unscaled
+  void setBrightness(uint8_t level) { brightness = level + 1; }
+  uint8_t getBrightness() const { return brightness - 1; }
+
+  uint8_t *getPixels() const { return pixels; }
+  uint16_t numPixels() const { return count; }
+
+  uint32_t showCount = 0;
+
+private:
+  uint16_t count;
+  uint8_t *pixels;
+  uint8_t brightness = 0;
+};
@@ -0,0 +1,164 @@
+// Minimal Arduino/ESP8266 surface for compiling main.ino on the host.
+// Time is a virtual CPU cycle counter that only moves when host code or the
+// sketch (delay, yield, getCycleCount) moves it.
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#define F_CPU 80000000L
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 3
+#define HEX 16
+#define DEC 10
+
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+
+#define PROGMEM
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+
+class __FlashStringHelper;
+#define F(x) (reinterpret_cast<const __FlashStringHelper *>(x))
+#define PSTR(x) (x)
+
+typedef uint8_t byte;
+
+namespace host
+{
+  extern uint64_t cycles;        // Virtual clock, F_CPU ticks per second
+  extern uint32_t cyclesPerRead; // Added by every ESP.getCycleCount() call
+  extern uint32_t gpi;           // Input levels, bit n = GPIO n (bit 16 = GPIO16)
+  extern uint32_t gpo;           // Output levels driven through GPOS/GPOC
+  extern void (*onGpioWrite)(uint32_t levels, uint64_t cycle);
+  extern std::string serialInput;
+  extern uint64_t allocations; // operator new calls so far
+  extern int64_t heapInUse;    // Bytes held through operator new
+  extern uint8_t flash[4096];  // The emulated settings sector
+  extern bool flashErased;     // flash has been filled with 0xFF
+  extern uint32_t flashErases;
+  extern uint32_t freeHeap;     // What ESP reports for heap and stack
+  extern uint32_t maxFreeBlock;
+  extern uint32_t freeContStack;
+
+  inline void advanceMicros(uint64_t us) { cycles += us * (F_CPU / 1000000); }
+  inline void advanceMillis(uint64_t ms) { advanceMicros(ms * 1000); }
+  inline uint64_t nowMicros() { return cycles / (F_CPU / 1000000); }
+
+  // Output register write: GPOS sets bits, GPOC clears them
+  struct GpioOutputRegister
+  {
+    bool set;
+    void operator=(uint32_t mask)
+    {
+      gpo = set ? (gpo | mask) : (gpo & ~mask);
+      if (onGpioWrite != nullptr)
+        onGpioWrite(gpo, cycles);
+    }
+  };
+  extern GpioOutputRegister gpioSet;
+  extern GpioOutputRegister gpioClear;
+}
+
+#define GPI (host::gpi & 0xFFFF)
+#define GP16I ((host::gpi >> 16) & 1)
+#define GPOS host::gpioSet
+#define GPOC host::gpioClear
+
+inline uint32_t millis() { return static_cast<uint32_t>(host::nowMicros() / 1000); }
+inline uint32_t micros() { return static_cast<uint32_t>(host::nowMicros()); }
+inline void delay(uint32_t ms) { host::advanceMillis(ms); }
+inline void delayMicroseconds(uint32_t us) { host::advanceMicros(us); }
+inline void yield() { host::advanceMicros(1); }
+
+inline long random(long max) { return max > 0 ? rand() % max : 0; }
+inline long random(long min, long max) { return max > min ? min + rand() % (max - min) : min; }
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t pin) { return (host::gpi >> pin) & 1; }
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalPinToInterrupt(int pin) { return pin; }
+inline void attachInterrupt(int, void (*)(), int) {}
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+inline uint8_t pgm_read_byte(const void *p) { return *static_cast<const uint8_t *>(p); }
+inline uint16_t pgm_read_word(const void *p)
+{
+  uint16_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+inline void *memcpy_P(void *dest, const void *src, size_t n) { return memcpy(dest, src, n); }
+
+class HardwareSerial
+{
+public:
+  void begin(unsigned long) {}
+  int available() { return static_cast<int>(host::serialInput.size()); }
+  int read()
+  {
+    if (host::serialInput.empty())
+      return -1;
+    char c = host::serialInput[0];
+    host::serialInput.erase(0, 1);
+    return static_cast<uint8_t>(c);
+  }
+  int availableForWrite() { return 128; }
+
+  size_t write(uint8_t c) { return fwrite(&c, 1, 1, stdout); }
+  size_t write(const uint8_t *data, size_t n) { return fwrite(data, 1, n, stdout); }
+
+  size_t print(const __FlashStringHelper *s) { return ::printf("%s", reinterpret_cast<const char *>(s)); }
+  size_t print(const char *s) { return ::printf("%s", s); }
+  size_t print(char c) { return ::printf("%c", c); }
+  size_t print(unsigned char v, int base = DEC) { return print(static_cast<unsigned long>(v), base); }
+  size_t print(int v, int base = DEC) { return print(static_cast<long>(v), base); }
+  size_t print(unsigned int v, int base = DEC) { return print(static_cast<unsigned long>(v), base); }
+  size_t print(long v, int base = DEC) { return base == HEX ? ::printf("%lX", v) : ::printf("%ld", v); }
+  size_t print(unsigned long v, int base = DEC) { return base == HEX ? ::printf("%lX", v) : ::printf("%lu", v); }
+
+  size_t println() { return ::printf("\n"); }
+  template <typename T>
+  size_t println(T value) { return print(value) + println(); }
+  template <typename T>
+  size_t println(T value, int base) { return print(value, base) + println(); }
+};
+extern HardwareSerial Serial;
+
+class EspClass
+{
+public:
+  uint32_t getCycleCount()
+  {
+    host::cycles += host::cyclesPerRead;
+    return static_cast<uint32_t>(host::cycles);
+  }
+  uint8_t getCpuFreqMHz() { return F_CPU / 1000000; }
+  uint32_t getFreeHeap() { return host::freeHeap; }
+  uint32_t getMaxFreeBlockSize() { return host::maxFreeBlock; }
+  uint32_t getFreeContStack() { return host::freeContStack; }
+  void resetFreeContStack() {}
+
+  // 4 KB emulated flash sector for the settings log
+  bool flashRead(uint32_t address, uint32_t *data, size_t size);
+  bool flashWrite(uint32_t address, const uint32_t *data, size_t size);
+  bool flashEraseSector(uint32_t sector);
+};
+extern EspClass ESP;
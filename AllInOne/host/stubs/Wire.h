@@ -0,0 +1,69 @@
+// Host stand-in for the I2C Wire library: one device with a 128-byte register
+// file. Tests fill registers directly or through onRead before each read.
+#pragma once
+
+#include <Arduino.h>
+
+class TwoWire
+{
+public:
+  uint8_t address = 0x68;
+  bool present = true;
+  uint8_t registers[128] = {};
+  void (*onRead)(uint8_t reg, uint8_t count) = nullptr;
+  uint32_t transactions = 0;
+
+  void begin(int, int) {}
+  void setClock(uint32_t) {}
+
+  void beginTransmission(uint8_t target)
+  {
+    selected = target == address && present;
+    haveRegister = false;
+  }
+
+  size_t write(uint8_t value)
+  {
+    if (!haveRegister)
+    {
+      pointer = value & 0x7F;
+      haveRegister = true;
+    }
+    else
+    {
+      registers[pointer++ & 0x7F] = value;
+    }
+    return 1;
+  }
+
+  uint8_t endTransmission(bool = true)
+  {
+    transactions++;
+    return selected ? 0 : 2; // 2 = address NACK
+  }
+
+  uint8_t requestFrom(uint8_t target, uint8_t count)
+  {
+    if (target != address || !present)
+      return 0;
+    if (onRead != nullptr)
+      onRead(pointer, count);
+
+    length = count;
+    position = 0;
+    for (uint8_t i = 0; i < count; i++)
+      buffer[i] = registers[(pointer + i) & 0x7F];
+    return count;
+  }
+
+  int read() { return position < length ? buffer[position++] : -1; }
+
+private:
+  bool selected = false;
+  bool haveRegister = false;
+  uint8_t pointer = 0;
+  uint8_t buffer[32] = {};
+  uint8_t length = 0;
+  uint8_t position = 0;
+};
+extern TwoWire Wire;
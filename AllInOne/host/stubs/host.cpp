@@ -0,0 +1,98 @@
+// Definitions behind the host stubs
+#include <Arduino.h>
+#include <Wire.h>
+
+#include <cstddef>
+#include <new>
+
+namespace host
+{
+  uint64_t cycles = 0;
+  uint32_t cyclesPerRead = 0;
+  uint32_t gpi = 0xFFFFFFFF; // Buttons are active low with pull-ups
+  uint32_t gpo = 0;
+  void (*onGpioWrite)(uint32_t levels, uint64_t cycle) = nullptr;
+  std::string serialInput;
+  GpioOutputRegister gpioSet = {true};
+  GpioOutputRegister gpioClear = {false};
+
+  uint8_t flash[4096];
+  bool flashErased = false;
+  uint32_t flashErases = 0;
+
+  uint32_t freeHeap = 40000;
+  uint32_t maxFreeBlock = 30000;
+  uint32_t freeContStack = 3000;
+
+  uint64_t allocations = 0;
+  int64_t heapInUse = 0;
+}
+
+// Every operator new and delete goes through here so host::allocations counts
+// them. The block size sits in a header in front of the block.
+static const size_t ALLOC_HEADER = alignof(std::max_align_t);
+
+void *operator new(size_t size)
+{
+  uint8_t *block = static_cast<uint8_t *>(malloc(size + ALLOC_HEADER));
+  if (block == nullptr)
+    throw std::bad_alloc();
+  memcpy(block, &size, sizeof(size));
+  host::allocations++;
+  host::heapInUse += size;
+  return block + ALLOC_HEADER;
+}
+
+void operator delete(void *p) noexcept
+{
+  if (p == nullptr)
+    return;
+  uint8_t *block = static_cast<uint8_t *>(p) - ALLOC_HEADER;
+  size_t size;
+  memcpy(&size, block, sizeof(size));
+  host::heapInUse -= size;
+  free(block);
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+void operator delete[](void *p, size_t) noexcept { operator delete(p); }
+
+HardwareSerial Serial;
+EspClass ESP;
+TwoWire Wire;
+extern "C" uint32_t _EEPROM_start;
+uint32_t _EEPROM_start;
+
+static uint8_t *flashAt(uint32_t address)
+{
+  if (!host::flashErased)
+  {
+    memset(host::flash, 0xFF, sizeof(host::flash));
+    host::flashErased = true;
+  }
+  return &host::flash[address % sizeof(host::flash)];
+}
+
+bool EspClass::flashRead(uint32_t address, uint32_t *data, size_t size)
+{
+  memcpy(data, flashAt(address), size);
+  return true;
+}
+
+bool EspClass::flashWrite(uint32_t address, const uint32_t *data, size_t size)
+{
+  uint8_t *p = flashAt(address);
+  const uint8_t *src = reinterpret_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++)
+    p[i] &= src[i]; // Writes can only clear bits
+  return true;
+}
+
+bool EspClass::flashEraseSector(uint32_t)
+{
+  host::flashErases++;
+  memset(flashAt(0), 0xFF, sizeof(host::flash));
+  return true;
+}
@@ -0,0 +1,131 @@
+// Rasterizes short messages with TextScroller and reads back every 8-column
+// window that render() blits across the two eyes, checking the glyph columns,
+// the one-column steps, the wrap back to the lead-in and the eye split.
+#include "host.h"
+
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+static const RGB WHITE = {255, 255, 255};
+
+// The 8 display columns at scroll step, bit y set = row y lit
+static std::vector<uint8_t> windowAt(TextScroller &scroller, uint32_t step)
+{
+  scroller.restart();
+  host::advanceMillis(step * TEXT_SCROLL_MS);
+  MaskFrame frame;
+  frame.clear();
+  scroller.render(frame, WHITE);
+
+  std::vector<uint8_t> window;
+  for (uint8_t x = 0; x < 8; x++)
+  {
+    const EyeBuffer &eye = x < 4 ? frame.left : frame.right;
+    uint8_t column = 0;
+    for (uint8_t y = 0; y < 4; y++)
+    {
+      const RGB &pixel = eye[y][x & 3];
+      if (pixel.r == WHITE.r && pixel.g == WHITE.g && pixel.b == WHITE.b)
+        column |= 1 << y;
+      else if (pixel.r != 0 || pixel.g != 0 || pixel.b != 0)
+        check(false, "pixels are either the text color or off");
+    }
+    window.push_back(column);
+  }
+  return window;
+}
+
+// Checks every scroll step of the message against the expected bitmap
+static void checkScroll(TextScroller &scroller, const std::vector<uint8_t> &bitmap, const char *what)
+{
+  check(scroller.getDuration() == bitmap.size() * TEXT_SCROLL_MS, what);
+  for (uint32_t step = 0; step < bitmap.size() + 2; step++)
+  {
+    std::vector<uint8_t> window = windowAt(scroller, step);
+    for (uint8_t x = 0; x < 8; x++)
+    {
+      if (window[x] != bitmap[(step + x) % bitmap.size()])
+      {
+        printf("FAIL %s: step %u column %u is %X, expected %X\n", what, step, x, window[x],
+               bitmap[(step + x) % bitmap.size()]);
+        failures++;
+        return;
+      }
+    }
+  }
+}
+
+int main()
+{
+  TextScroller scroller;
+  const std::vector<uint8_t> leadIn(8, 0);
+
+  // Inner blank columns of " and % stay, . drops its blank edges
+  scroller.clear();
+  scroller.append("\"%.");
+  std::vector<uint8_t> expected = leadIn;
+  expected.insert(expected.end(), {0x3, 0x0, 0x3, 0x0});
+  expected.insert(expected.end(), {0xD, 0x0, 0xB, 0x0});
+  expected.insert(expected.end(), {0x8, 0x0});
+  checkScroll(scroller, expected, "quote, percent and period");
+
+  // Lowercase shows as uppercase, a space is two blank columns, '!' is one column
+  scroller.clear();
+  scroller.append("i !");
+  expected = leadIn;
+  expected.insert(expected.end(), {0x9, 0xF, 0x9, 0x0});
+  expected.insert(expected.end(), {0x0, 0x0});
+  expected.insert(expected.end(), {0xB, 0x0});
+  checkScroll(scroller, expected, "lowercase, space and bang");
+
+  // Characters outside the font show as '?'
+  TextScroller question;
+  question.clear();
+  question.append('?');
+  scroller.clear();
+  scroller.append('~');
+  check(scroller.getDuration() == question.getDuration() &&
+            windowAt(scroller, 8) == windowAt(question, 8),
+        "unknown character shown as '?'");
+
+  // Numbers rasterize like their digits
+  TextScroller digits;
+  digits.clear();
+  digits.append("105");
+  scroller.clear();
+  scroller.appendNumber(105);
+  bool same = scroller.getDuration() == digits.getDuration();
+  for (uint32_t step = 0; same && step * TEXT_SCROLL_MS < digits.getDuration(); step++)
+    same = windowAt(scroller, step) == windowAt(digits, step);
+  check(same, "appendNumber matches the digits");
+
+  // Long messages stop at the bitmap capacity
+  scroller.clear();
+  for (int i = 0; i < 100; i++)
+    scroller.append('W');
+  check(scroller.getDuration() == TEXT_MAX_COLUMNS * TEXT_SCROLL_MS, "bitmap capacity");
+
+  // Messages only show in ACTIVE, MANUAL never runs the scroll
+  modeManager.setMode(Core::Mode::MANUAL);
+  expressionManager.setExpression(Expressions::Type::Happy);
+  showMessage();
+  check(expressionManager.getCurrentExpression() == Expressions::Type::Happy, "no message in MANUAL");
+  modeManager.setMode(Core::Mode::ACTIVE);
+  showMessage();
+  check(expressionManager.getCurrentExpression() == Expressions::Type::Text &&
+            expressionManager.getBaseExpression() == Expressions::Type::Happy,
+        "message shown in ACTIVE over the base expression");
+
+  printf("%s\n", failures == 0 ? "text_test ok" : "text_test FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,221 @@
+// Runs the dual-lane WS2812 output against the GPOS/GPOC and cycle counter
+// stubs, logs the edge times of each data pin and checks every bit of both
+// lanes against the WS2812B datasheet windows, then decodes the bytes back.
+// Each ESP.getCycleCount() read costs a few cycles, so the busy-wait loops
+// overshoot the way they do on the chip.
+#define DUAL_LANE_OUTPUT 1
+#include "host.h"
+
+#include <vector>
+
+// Datasheet windows in ns
+#define T0H_MIN 250
+#define T0H_MAX 550
+#define T1H_MIN 650
+#define T1H_MAX 950
+#define T0L_MIN 450
+#define T1L_MIN 300
+#define PERIOD_MIN 650
+#define PERIOD_MAX 1850
+#define LATCH_MIN_NS 280000 // Reset time of current WS2812B parts
+
+struct Edge
+{
+  uint64_t cycle;
+  bool high;
+};
+
+struct Lane
+{
+  uint32_t mask;
+  const char *name;
+  std::vector<Edge> edges;
+};
+
+static Lane lanes[2] = {{1UL << NEO_PIN, "left"}, {1UL << NEO_PIN_RIGHT, "right"}};
+static uint32_t lastLevels = 0;
+static int failures = 0;
+
+static void onGpioWrite(uint32_t levels, uint64_t cycle)
+{
+  for (Lane &lane : lanes)
+  {
+    if ((levels ^ lastLevels) & lane.mask)
+      lane.edges.push_back({cycle, (levels & lane.mask) != 0});
+  }
+  lastLevels = levels;
+}
+
+static uint64_t toNs(uint64_t cycles)
+{
+  return cycles * 1000000000ULL / F_CPU;
+}
+
+static void fail(const Lane &lane, size_t bit, const char *what, uint64_t ns)
+{
+  if (failures < 20)
+    printf("FAIL %s bit %zu: %s %llu ns\n", lane.name, bit, what, static_cast<unsigned long long>(ns));
+  failures++;
+}
+
+// Checks the timing of every bit and returns the bytes they carry
+static std::vector<uint8_t> decode(const Lane &lane)
+{
+  std::vector<uint8_t> bytes;
+  const std::vector<Edge> &edges = lane.edges;
+  if (edges.size() % 2 != 0)
+  {
+    fail(lane, 0, "odd edge count", edges.size());
+    return bytes;
+  }
+
+  uint8_t value = 0;
+  for (size_t i = 0; i + 1 < edges.size(); i += 2)
+  {
+    size_t bit = i / 2;
+    if (!edges[i].high || edges[i + 1].high)
+    {
+      fail(lane, bit, "edges out of order", 0);
+      return bytes;
+    }
+
+    uint64_t highNs = toNs(edges[i + 1].cycle - edges[i].cycle);
+    bool one = highNs >= T1H_MIN;
+    if (one && highNs > T1H_MAX)
+      fail(lane, bit, "T1H", highNs);
+    if (!one && (highNs < T0H_MIN || highNs > T0H_MAX))
+      fail(lane, bit, "T0H", highNs);
+
+    if (i + 2 < edges.size())
+    {
+      uint64_t lowNs = toNs(edges[i + 2].cycle - edges[i + 1].cycle);
+      uint64_t periodNs = toNs(edges[i + 2].cycle - edges[i].cycle);
+      if (lowNs < (one ? T1L_MIN : T0L_MIN))
+        fail(lane, bit, one ? "T1L" : "T0L", lowNs);
+      if (periodNs < PERIOD_MIN || periodNs > PERIOD_MAX)
+        fail(lane, bit, "period", periodNs);
+    }
+
+    value = (value << 1) | (one ? 1 : 0);
+    if (bit % 8 == 7)
+      bytes.push_back(value);
+  }
+  return bytes;
+}
+
+static void clearEdges()
+{
+  for (Lane &lane : lanes)
+    lane.edges.clear();
+}
+
+// Every bit starts on both lanes at once
+static void checkSharedRisingEdges()
+{
+  const std::vector<Edge> &left = lanes[0].edges;
+  const std::vector<Edge> &right = lanes[1].edges;
+  if (left.size() != right.size())
+  {
+    fail(lanes[1], 0, "edge count differs from left", left.size());
+    return;
+  }
+  for (size_t i = 0; i < left.size(); i += 2)
+  {
+    if (left[i].cycle != right[i].cycle)
+    {
+      fail(lanes[1], i / 2, "rising edge apart from left by", toNs(right[i].cycle - left[i].cycle));
+      return;
+    }
+  }
+}
+
+static void fill(MaskFrame &frame, const RGB &left, const RGB &right)
+{
+  for (uint8_t y = 0; y < 4; y++)
+  {
+    for (uint8_t x = 0; x < 4; x++)
+    {
+      frame.left[y][x] = left;
+      frame.right[y][x] = right;
+    }
+  }
+}
+
+// Solid colors make the expected stream independent of the panel wiring
+static void checkSolid(const RGB &left, const RGB &right)
+{
+  MaskFrame frame;
+  fill(frame, left, right);
+  clearEdges();
+  ledController.present(frame);
+  checkSharedRisingEdges();
+
+  const RGB *colors[2] = {&left, &right};
+  for (uint8_t side = 0; side < 2; side++)
+  {
+    std::vector<uint8_t> bytes = decode(lanes[side]);
+    bool ok = bytes.size() == NEO_NUMPIXEL_PER * 3;
+    for (size_t i = 0; ok && i < bytes.size(); i += 3)
+    {
+      ok = bytes[i] == colors[side]->g && bytes[i + 1] == colors[side]->r && bytes[i + 2] == colors[side]->b;
+    }
+    if (!ok)
+      fail(lanes[side], 0, "decoded bytes differ, count", bytes.size());
+  }
+}
+
+int main()
+{
+  host::onGpioWrite = onGpioWrite;
+  host::cyclesPerRead = 1;
+  setup();
+  ledController.setBrightness(255);
+
+  static const uint32_t CYCLES_PER_READ[] = {1, 3, 7};
+  for (uint32_t cyclesPerRead : CYCLES_PER_READ)
+  {
+    host::cyclesPerRead = cyclesPerRead;
+
+    checkSolid({0x12, 0xA5, 0xFF}, {0xED, 0x5A, 0x00});
+    checkSolid({0x00, 0x00, 0x00}, {0xFF, 0xFF, 0xFF});
+    checkSolid({0xFF, 0xFF, 0xFF}, {0x00, 0x00, 0x00});
+
+    // Every renderer's frame must go out in spec, whatever its bytes are
+    for (uint8_t type = 0; type < static_cast<uint8_t>(Expressions::Type::SIZE); type++)
+    {
+      MaskFrame frame;
+      Expressions::render(static_cast<Expressions::Type>(type), frame);
+      clearEdges();
+      ledController.present(frame);
+      checkSharedRisingEdges();
+      for (Lane &lane : lanes)
+      {
+        if (decode(lane).size() != NEO_NUMPIXEL_PER * 3)
+          fail(lane, 0, "byte count for renderer", type);
+      }
+    }
+
+    // Back-to-back frames are held low for the latch time in between
+    MaskFrame frame;
+    fill(frame, {0xFF, 0xFF, 0xFF}, {0xFF, 0xFF, 0xFF});
+    clearEdges();
+    ledController.present(frame);
+    ledController.present(frame);
+    for (Lane &lane : lanes)
+    {
+      const std::vector<Edge> &edges = lane.edges;
+      size_t frameEdges = NEO_NUMPIXEL_PER * 3 * 8 * 2;
+      if (edges.size() != frameEdges * 2)
+      {
+        fail(lane, 0, "edge count for two frames", edges.size());
+        continue;
+      }
+      uint64_t gapNs = toNs(edges[frameEdges].cycle - edges[frameEdges - 1].cycle);
+      if (gapNs < LATCH_MIN_NS)
+        fail(lane, frameEdges / 2, "latch gap", gapNs);
+    }
+  }
+
+  printf("%s\n", failures == 0 ? "wave_test ok" : "wave_test FAILED");
+  return failures == 0 ? 0 : 1;
+}
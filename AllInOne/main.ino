@@ -1,8 +1,173 @@
 #include <Arduino.h>
 #include <Adafruit_NeoPixel.h>
+#include <Wire.h>
 #include <cstdint>
 #include <functional>
 
+// ============================================
+// LOGGING
+// ============================================
+
+// Log calls only copy an 8-byte record into a ring buffer; nothing touches the
+// UART until Logger::drain() runs in the idle part of loop(), and drain() only
+// writes what fits in the UART FIFO. Calls above LOG_LEVEL compile to nothing.
+//
+// By default each record is sent as 0x7E followed by the raw LogRecord bytes
+// (little endian) and formatted on the host by host/log_decode.py, which
+// passes other serial output through. Set LOG_BINARY to 0 to format records
+// as short text lines on the device instead.
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+
+#define LOG_LEVEL LOG_LEVEL_INFO
+#ifndef LOG_BINARY
+#define LOG_BINARY 1
+#endif
+#define LOG_BUFFER_SIZE 32 // Records, must be a power of two
+#define LOG_SYNC_BYTE 0x7E
+
+enum class LogEvent : uint8_t
+{
+  // The button events follow the order of ButtonHandler::ButtonEvent
+  ButtonTap,
+  ButtonDoubleTap,
+  ButtonHold,
+  ButtonRelease,
+  TooManyButtons,
+  HealthError,
+  ImuMissing,
+  HealthStat, // arg0 = HealthStat, arg1 = value, saturated
+  COUNT
+};
+
+struct LogRecord
+{
+  uint32_t timestamp; // millis()
+  uint8_t event;      // LogEvent
+  uint8_t arg0;
+  uint16_t arg1;
+};
+
+// Single producer (the main loop), single consumer (drain)
+class Logger
+{
+public:
+  void push(LogEvent event, uint8_t arg0 = 0, uint16_t arg1 = 0)
+  {
+    if (muted)
+      return;
+
+    uint8_t next = (head + 1) & (LOG_BUFFER_SIZE - 1);
+    if (next == tail)
+    {
+      dropped++;
+      return;
+    }
+
+    LogRecord &record = records[head];
+    record.timestamp = millis();
+    record.event = static_cast<uint8_t>(event);
+    record.arg0 = arg0;
+    record.arg1 = arg1;
+    head = next;
+  }
+
+  void drain()
+  {
+    while (tail != head)
+    {
+      const LogRecord &record = records[tail];
+
+#if LOG_BINARY
+      if (Serial.availableForWrite() < static_cast<int>(sizeof(LogRecord) + 1))
+        return;
+      Serial.write(LOG_SYNC_BYTE);
+      Serial.write(reinterpret_cast<const uint8_t *>(&record), sizeof(LogRecord));
+#else
+      char line[48];
+      int length = snprintf(line, sizeof(line), "[%lu] %s %u %u\n",
+                            static_cast<unsigned long>(record.timestamp), getEventName(record.event),
+                            record.arg0, record.arg1);
+      if (length < 0 || length >= static_cast<int>(sizeof(line)))
+        length = sizeof(line) - 1;
+      if (Serial.availableForWrite() < length)
+        return;
+      Serial.write(reinterpret_cast<const uint8_t *>(line), length);
+#endif
+
+      tail = (tail + 1) & (LOG_BUFFER_SIZE - 1);
+    }
+
+    if (dropped > 0 && Serial.availableForWrite() >= 24)
+    {
+      Serial.print(F("[log] dropped "));
+      Serial.println(dropped);
+      dropped = 0;
+    }
+  }
+
+  // While muted, push() drops records, e.g. during a replay whose events
+  // would otherwise carry real timestamps
+  void setMuted(bool value)
+  {
+    muted = value;
+  }
+
+  static const char *getEventName(uint8_t event)
+  {
+    switch (static_cast<LogEvent>(event))
+    {
+    case LogEvent::ButtonTap:
+      return "Tap";
+    case LogEvent::ButtonDoubleTap:
+      return "DoubleTap";
+    case LogEvent::ButtonHold:
+      return "Hold";
+    case LogEvent::ButtonRelease:
+      return "Release";
+    case LogEvent::TooManyButtons:
+      return "TooManyButtons";
+    case LogEvent::HealthError:
+      return "HealthError";
+    case LogEvent::ImuMissing:
+      return "ImuMissing";
+    case LogEvent::HealthStat:
+      return "HealthStat";
+    default:
+      return "Unknown";
+    }
+  }
+
+private:
+  LogRecord records[LOG_BUFFER_SIZE] = {};
+  volatile uint8_t head = 0;
+  volatile uint8_t tail = 0;
+  uint16_t dropped = 0;
+  bool muted = false;
+};
+
+Logger logger;
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) logger.push(__VA_ARGS__)
+#else
+#define LOG_ERROR(...)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) logger.push(__VA_ARGS__)
+#else
+#define LOG_INFO(...)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) logger.push(__VA_ARGS__)
+#else
+#define LOG_DEBUG(...)
+#endif
+
 // ============================================
 // FRAMEBUFFER DEFINITIONS
 // ============================================
@@ -14,10 +179,21 @@ struct RGB
   uint8_t b;
 };
 
+// One 4x4 eye, indexed [y][x]
+typedef RGB EyeBuffer[4][4];
+
+// Constant color tables are kept in flash; read entries through this helper
+static inline RGB readProgmemColor(const RGB *color)
+{
+  RGB result;
+  memcpy_P(&result, color, sizeof(RGB));
+  return result;
+}
+
 struct MaskFrame
 {
-  RGB left[4][4];
-  RGB right[4][4];
+  EyeBuffer left;
+  EyeBuffer right;
 
   void clear()
   {
@@ -30,9 +206,82 @@ struct MaskFrame
       }
     }
   }
+
+  // Crossfades from the given frame to this one, mix 0 = from, 255 = this
+  void blendFrom(const MaskFrame &from, uint8_t mix)
+  {
+    for (uint8_t y = 0; y < 4; y++)
+    {
+      for (uint8_t x = 0; x < 4; x++)
+      {
+        left[y][x] = blend(from.left[y][x], left[y][x], mix);
+        right[y][x] = blend(from.right[y][x], right[y][x], mix);
+      }
+    }
+  }
+
+private:
+  static RGB blend(const RGB &a, const RGB &b, uint8_t mix)
+  {
+    return {static_cast<uint8_t>(a.r + (b.r - a.r) * mix / 255),
+            static_cast<uint8_t>(a.g + (b.g - a.g) * mix / 255),
+            static_cast<uint8_t>(a.b + (b.b - a.b) * mix / 255)};
+  }
+};
+
+// 4 bits per pixel plus a 16-entry palette. Animations that only change colors
+// can update a few palette entries per frame instead of redrawing every pixel;
+// the frame is expanded to RGB when presented.
+struct IndexedFrame
+{
+  uint8_t pixels[2][4][2]; // [eye][y][x / 2], even x in the low nibble
+  RGB palette[16];
+  uint8_t layout; // Owner tag for the current pixel indices, 0 = none
+  uint8_t phase;  // Last animation step written to the palette by the owner
+
+  void clear()
+  {
+    memset(pixels, 0, sizeof(pixels));
+    memset(palette, 0, sizeof(palette));
+    layout = 0;
+    phase = 0xFF;
+  }
+
+  void setPixel(uint8_t eye, uint8_t x, uint8_t y, uint8_t index)
+  {
+    uint8_t &cell = pixels[eye][y][x >> 1];
+    if (x & 1)
+    {
+      cell = (cell & 0x0F) | (index << 4);
+    }
+    else
+    {
+      cell = (cell & 0xF0) | (index & 0x0F);
+    }
+  }
+
+  uint8_t getPixel(uint8_t eye, uint8_t x, uint8_t y) const
+  {
+    uint8_t cell = pixels[eye][y][x >> 1];
+    return (x & 1) ? (cell >> 4) : (cell & 0x0F);
+  }
+
+  void expand(MaskFrame &frame) const
+  {
+    for (uint8_t y = 0; y < 4; y++)
+    {
+      for (uint8_t x = 0; x < 4; x++)
+      {
+        frame.left[y][x] = palette[getPixel(0, x, y)];
+        frame.right[y][x] = palette[getPixel(1, x, y)];
+      }
+    }
+  }
 };
 
-static MaskFrame getErrorFrame()
+// Blinks a red diagonal on the left eye. The right eye shows the error code as
+// that many lit pixels, or the same diagonal when no code is given.
+static MaskFrame getErrorFrame(uint8_t errorCode = 0)
 {
   static uint32_t lastToggle = 0;
   static bool on = false;
@@ -51,7 +300,15 @@ static MaskFrame getErrorFrame()
     for (uint8_t i = 0; i < 4; i++)
     {
       frame.left[i][i] = {255, 0, 0};
-      frame.right[i][i] = {255, 0, 0};
+      if (errorCode == 0)
+      {
+        frame.right[i][i] = {255, 0, 0};
+      }
+    }
+
+    for (uint8_t i = 0; i < errorCode && i < 16; i++)
+    {
+      frame.right[i / 4][i % 4] = {255, 0, 0};
     }
   }
 
@@ -115,6 +372,157 @@ public:
   }
 };
 
+// ============================================
+// TEXT SCROLLER
+// ============================================
+
+// Messages are rasterized once into a packed column bitmap (4 rows per column,
+// two columns per byte) using a 3x4 font in flash. Each frame then copies an
+// 8-column window of the bitmap across both eyes, left eye first.
+#define TEXT_MAX_COLUMNS 160 // Bitmap capacity, about 40 characters
+#define TEXT_SCROLL_MS 120   // Time per one-column step
+
+class TextScroller
+{
+public:
+  // Empties the message, ready for append()
+  void clear()
+  {
+    memset(columns, 0, sizeof(columns));
+    columnCount = DISPLAY_COLUMNS; // Blank lead-in so text enters from the right
+    startTime = millis();
+  }
+
+  // Rasterizes one character; lowercase is shown as uppercase and anything
+  // else outside the font as '?'
+  void append(char c)
+  {
+    if (c >= 'a' && c <= 'z')
+      c -= 'a' - 'A';
+    if (c < FONT_FIRST || c > FONT_LAST)
+      c = '?';
+
+    if (c == ' ')
+    {
+      appendColumn(0);
+      appendColumn(0);
+      return;
+    }
+
+    // Narrow glyphs drop their blank edge columns; inner gaps (" %) stay
+    uint16_t glyph = getGlyph(c);
+    uint8_t first = 0;
+    uint8_t last = 2;
+    while (first < last && ((glyph >> (first * 4)) & 0x0F) == 0)
+      first++;
+    while (last > first && ((glyph >> (last * 4)) & 0x0F) == 0)
+      last--;
+    for (uint8_t x = first; x <= last; x++)
+      appendColumn((glyph >> (x * 4)) & 0x0F);
+    appendColumn(0);
+  }
+
+  void append(const char *text)
+  {
+    while (*text != '\0')
+      append(*text++);
+  }
+
+  void append(const __FlashStringHelper *text)
+  {
+    const char *p = reinterpret_cast<const char *>(text);
+    char c;
+    while ((c = pgm_read_byte(p++)) != '\0')
+      append(c);
+  }
+
+  void appendNumber(uint32_t number)
+  {
+    char digits[11];
+    uint8_t count = 0;
+    do
+    {
+      digits[count++] = '0' + number % 10;
+      number /= 10;
+    } while (number != 0);
+
+    while (count > 0)
+      append(digits[--count]);
+  }
+
+  // Restarts the scroll from the blank lead-in
+  void restart()
+  {
+    startTime = millis();
+  }
+
+  // Time for the message to scroll fully across and off the display
+  uint32_t getDuration() const
+  {
+    return static_cast<uint32_t>(columnCount) * TEXT_SCROLL_MS;
+  }
+
+  void render(MaskFrame &frame, const RGB &color) const
+  {
+    uint16_t offset = ((millis() - startTime) / TEXT_SCROLL_MS) % columnCount;
+
+    for (uint8_t x = 0; x < DISPLAY_COLUMNS; x++)
+    {
+      uint8_t column = getColumn((offset + x) % columnCount);
+      EyeBuffer &eye = x < 4 ? frame.left : frame.right;
+      for (uint8_t y = 0; y < 4; y++)
+      {
+        eye[y][x & 3] = (column & (1 << y)) ? color : RGB{0, 0, 0};
+      }
+    }
+  }
+
+private:
+  static const uint8_t DISPLAY_COLUMNS = 8;
+  static const char FONT_FIRST = ' ';
+  static const char FONT_LAST = 'Z';
+
+  uint8_t columns[TEXT_MAX_COLUMNS / 2] = {};
+  uint16_t columnCount = DISPLAY_COLUMNS;
+  uint32_t startTime = 0;
+
+  void appendColumn(uint8_t column)
+  {
+    if (columnCount >= TEXT_MAX_COLUMNS)
+      return;
+
+    uint8_t &cell = columns[columnCount >> 1];
+    if (columnCount & 1)
+      cell = (cell & 0x0F) | (column << 4);
+    else
+      cell = (cell & 0xF0) | column;
+    columnCount++;
+  }
+
+  uint8_t getColumn(uint16_t index) const
+  {
+    uint8_t cell = columns[index >> 1];
+    return (index & 1) ? (cell >> 4) : (cell & 0x0F);
+  }
+
+  // Three 4-bit columns, left column in the low bits, top row in bit 0 of each
+  static uint16_t getGlyph(char c)
+  {
+    static const uint16_t FONT[FONT_LAST - FONT_FIRST + 1] PROGMEM = {
+        0x000, 0x0B0, 0x303, 0xF6F, 0x5FA, 0xB0D, 0xA5A, 0x030, //   ! " # $ % & '
+        0x096, 0x690, 0x525, 0x4E4, 0x048, 0x222, 0x080, 0x348, // ( ) * + , - . /
+        0xF9F, 0x8FA, 0xAD9, 0xFB9, 0xF47, 0x5BB, 0xEAF, 0x3D1, // 0 1 2 3 4 5 6 7
+        0xDBD, 0xF57, 0x0A0, 0x058, 0x052, 0xAAA, 0x250, 0x291, // 8 9 : ; < = > ?
+        0xB9F, 0xE5E, 0xEBF, 0x996, 0x69F, 0x9BF, 0x15F, 0xD96, // @ A B C D E F G
+        0xF2F, 0x9F9, 0x784, 0x96F, 0x88F, 0xF3F, 0xE1F, 0x696, // H I J K L M N O
+        0x25F, 0xAD6, 0xA5F, 0x59A, 0x1F1, 0xF8F, 0x787, 0xFCF, // P Q R S T U V W
+        0x969, 0x3C3, 0xB9D                                     // X Y Z
+    };
+
+    return pgm_read_word(&FONT[c - FONT_FIRST]);
+  }
+};
+
 // ============================================
 // EXPRESSIONS
 // ============================================
@@ -142,54 +550,65 @@ public:
     BinaryClock,
     Matrix,
     Loading,
+    Text,
     SIZE
   };
 
+  // How the right eye is derived from the left one after rendering
+  enum class Symmetry
+  {
+    Copy,       // Right eye is identical to the left eye
+    Mirror,     // Right eye is the left eye flipped horizontally
+    Independent // Renderer draws both eyes itself
+  };
+
   static void render(Type type, MaskFrame &frame)
   {
     switch (type)
     {
     case Type::Neutral:
-      renderNeutral(frame);
+      renderNeutral(frame.left);
       break;
     case Type::Happy:
-      renderHappy(frame);
+      renderHappy(frame.left);
       break;
     case Type::Sad:
-      renderSad(frame);
+      renderSad(frame.left);
       break;
     case Type::Angry:
-      renderAngry(frame);
+      renderAngry(frame.left);
       break;
     case Type::Surprised:
-      renderSurprised(frame);
+      renderSurprised(frame.left);
       break;
     case Type::Wink:
       renderWink(frame);
       break;
     case Type::Shy:
-      renderShy(frame);
+      renderShy(frame.left);
       break;
     case Type::Lovely:
       renderLovely(frame);
       break;
     case Type::Rainbow:
-      renderRainbow(frame);
+    case Type::Flashing:
+    {
+      static IndexedFrame scratch = {};
+      renderIndexed(type, scratch);
+      scratch.expand(frame);
       break;
+    }
     case Type::Music:
       renderMusic(frame);
       break;
-    case Type::Flashing:
-      renderFlashing(frame, 255, 255, 255, 200);
-      break;
     case Type::Dead:
-      renderDead(frame);
+      renderDead(frame.left);
       break;
     case Type::Check:
-      renderCheck(frame);
+      renderCheck(frame.left);
       break;
     case Type::BigEyes:
-      renderBigEyes(frame);
+      renderBigEyes(frame.left);
       break;
     case Type::BinaryClock:
       renderBinaryClock(frame, 255, 255, 255, millis());
@@ -198,16 +617,181 @@ public:
       renderMatrix(frame);
       break;
     case Type::Loading:
-      renderLoading(frame);
+      renderLoading(frame.left);
+      break;
+    case Type::Text:
+      getTextScroller().render(frame, {255, 255, 255});
+      break;
+    default:
+      type = Type::Neutral;
+      renderNeutral(frame.left);
+      break;
+    }
+
+    applySymmetry(frame, getSymmetry(type));
+  }
+
+  // Look direction (see getLookShift) that Neutral holds instead of glancing
+  // around at random, -1 for none
+  static void setGaze(int8_t direction)
+  {
+    gazeDirection() = direction;
+  }
+
+  // Message shown by the Text expression
+  static TextScroller &getTextScroller()
+  {
+    static TextScroller scroller;
+    return scroller;
+  }
+
+  // Expressions that only animate colors and draw through an IndexedFrame
+  static bool isIndexed(Type type)
+  {
+    return type == Type::Rainbow || type == Type::Flashing;
+  }
+
+  // Updates an indexed frame for an expression where isIndexed() is true. Pixel
+  // indices are only rewritten when the frame was last laid out by another type.
+  static void renderIndexed(Type type, IndexedFrame &frame)
+  {
+    uint8_t layout = static_cast<uint8_t>(type) + 1;
+    bool relayout = frame.layout != layout;
+    if (relayout)
+    {
+      frame.layout = layout;
+      frame.phase = 0xFF;
+    }
+
+    switch (type)
+    {
+    case Type::Rainbow:
+      renderRainbow(frame, relayout);
+      break;
+    case Type::Flashing:
+      renderFlashing(frame, relayout, 255, 255, 255, 200);
       break;
     default:
-      renderNeutral(frame);
       break;
     }
   }
 
+  static Symmetry getSymmetry(Type type)
+  {
+    switch (type)
+    {
+    case Type::Happy:
+    case Type::Sad:
+    case Type::Angry:
+    case Type::Surprised:
+      return Symmetry::Mirror;
+    case Type::Wink:
+    case Type::Lovely:
+    case Type::Rainbow:
+    case Type::Music:
+    case Type::Flashing:
+    case Type::BinaryClock:
+    case Type::Matrix:
+    case Type::Text:
+      return Symmetry::Independent;
+    default:
+      return Symmetry::Copy;
+    }
+  }
+
+  static const __FlashStringHelper *getName(Type type)
+  {
+    switch (type)
+    {
+    case Type::Neutral:
+      return F("Neutral");
+    case Type::Happy:
+      return F("Happy");
+    case Type::Sad:
+      return F("Sad");
+    case Type::Angry:
+      return F("Angry");
+    case Type::Surprised:
+      return F("Surprised");
+    case Type::Wink:
+      return F("Wink");
+    case Type::Shy:
+      return F("Shy");
+    case Type::Lovely:
+      return F("Lovely");
+    case Type::Rainbow:
+      return F("Rainbow");
+    case Type::Music:
+      return F("Music");
+    case Type::Flashing:
+      return F("Flashing");
+    case Type::Dead:
+      return F("Dead");
+    case Type::Check:
+      return F("Check");
+    case Type::BigEyes:
+      return F("BigEyes");
+    case Type::BinaryClock:
+      return F("BinaryClock");
+    case Type::Matrix:
+      return F("Matrix");
+    case Type::Loading:
+      return F("Loading");
+    case Type::Text:
+      return F("Text");
+    default:
+      return F("Unknown");
+    }
+  }
+
 private:
-  static void renderNeutral(MaskFrame &frame)
+  static void applySymmetry(MaskFrame &frame, Symmetry symmetry)
+  {
+    switch (symmetry)
+    {
+    case Symmetry::Copy:
+      memcpy(frame.right, frame.left, sizeof(EyeBuffer));
+      break;
+    case Symmetry::Mirror:
+      for (uint8_t y = 0; y < 4; y++)
+      {
+        for (uint8_t x = 0; x < 4; x++)
+        {
+          frame.right[y][3 - x] = frame.left[y][x];
+        }
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  static int8_t &gazeDirection()
+  {
+    static int8_t direction = -1;
+    return direction;
+  }
+
+  // Pupil offset in pixel indices for each random look direction
+  static int8_t getLookShift(int8_t lookDirection)
+  {
+    static const int8_t LOOK_SHIFTS[8] PROGMEM = {
+        1,  // right
+        -1, // left
+        4,  // down
+        -4, // up
+        5,  // right-down
+        3,  // left-down
+        -3, // right-up
+        -5  // left-up
+    };
+
+    if (lookDirection < 0 || lookDirection >= 8)
+      return 0;
+    return static_cast<int8_t>(pgm_read_byte(&LOOK_SHIFTS[lookDirection]));
+  }
+
+  static void renderNeutral(EyeBuffer &eye)
   {
     uint8_t r = 255;
     uint8_t g = 255;
@@ -276,42 +860,13 @@ private:
     }
 
     int8_t pixelShift = 0;
-    if (isLooking && !isBlinking)
+    if (!isBlinking && gazeDirection() >= 0)
     {
-      // lookDirection: 0 = right, 1 = left, 2 = down, 3 = up
-      // Adjust to support 8 directions: 0-7
-      // 0=right, 1=left, 2=down, 3=up, 4=right-down, 5=left-down, 6=right-up, 7=left-up
-
-      switch (lookDirection)
-      {
-      case 0: // right
-        pixelShift = 1;
-        break;
-      case 1: // left
-        pixelShift = -1;
-        break;
-      case 2: // down
-        pixelShift = 4;
-        break;
-      case 3: // up
-        pixelShift = -4;
-        break;
-      case 4: // right-down
-        pixelShift = 5;
-        break;
-      case 5: // left-down
-        pixelShift = 3;
-        break;
-      case 6: // right-up
-        pixelShift = -3;
-        break;
-      case 7: // left-up
-        pixelShift = -5;
-        break;
-      default:
-        pixelShift = 0;
-        break;
-      }
+      pixelShift = getLookShift(gazeDirection());
+    }
+    else if (isLooking && !isBlinking)
+    {
+      pixelShift = getLookShift(lookDirection);
     }
 
     for (uint8_t y = 0; y < 4; y++)
@@ -336,13 +891,12 @@ private:
           }
         }
 
-        frame.left[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
-        frame.right[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
+        eye[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
       }
     }
   }
 
-  static void renderHappy(MaskFrame &frame)
+  static void renderHappy(EyeBuffer &eye)
   {
     uint8_t r = 255;
     uint8_t g = 115;
@@ -388,13 +942,12 @@ private:
           }
         }
 
-        frame.left[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
-        frame.right[y][3 - x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
+        eye[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
       }
     }
   }
 
-  static void renderSad(MaskFrame &frame)
+  static void renderSad(EyeBuffer &eye)
   {
     uint8_t r = 46;
     uint8_t g = 88;
@@ -416,13 +969,12 @@ private:
           intensity = 0;
         }
 
-        frame.left[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
-        frame.right[y][3 - x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
+        eye[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
       }
     }
   }
 
-  static void renderSurprised(MaskFrame &frame)
+  static void renderSurprised(EyeBuffer &eye)
   {
     uint8_t r = 255;
     uint8_t g = 255;
@@ -445,13 +997,12 @@ private:
           intensity = 0;
         }*/
 
-        frame.left[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
-        frame.right[y][3 - x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
+        eye[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
       }
     }
   }
 
-  static void renderAngry(MaskFrame &frame)
+  static void renderAngry(EyeBuffer &eye)
   {
     uint8_t r = 255;
     uint8_t g = 0;
@@ -473,8 +1024,7 @@ private:
           intensity = 0;
         }
 
-        frame.left[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
-        frame.right[y][3 - x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
+        eye[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
       }
     }
   }
@@ -580,7 +1130,7 @@ private:
     }
   }
 
-  static void renderShy(MaskFrame &frame)
+  static void renderShy(EyeBuffer &eye)
   {
     uint8_t r = 255;
     uint8_t g = 80;
@@ -651,36 +1201,7 @@ private:
     int8_t pixelShift = 0;
     if (isLooking && !isBlinking)
     {
-      switch (lookDirection)
-      {
-      case 0: // right
-        pixelShift = 1;
-        break;
-      case 1: // left
-        pixelShift = -1;
-        break;
-      case 2: // down
-        pixelShift = 4;
-        break;
-      case 3: // up
-        pixelShift = -4;
-        break;
-      case 4: // right-down
-        pixelShift = 5;
-        break;
-      case 5: // left-down
-        pixelShift = 3;
-        break;
-      case 6: // right-up
-        pixelShift = -3;
-        break;
-      case 7: // left-up
-        pixelShift = -5;
-        break;
-      default:
-        pixelShift = 0;
-        break;
-      }
+      pixelShift = getLookShift(lookDirection);
     }
 
     for (uint8_t y = 0; y < 4; y++)
@@ -732,8 +1253,7 @@ private:
           finalB = 0;
         }
 
-        frame.left[y][x] = {finalR, finalG, finalB};
-        frame.right[y][x] = {finalR, finalG, finalB};
+        eye[y][x] = {finalR, finalG, finalB};
       }
     }
   }
@@ -750,7 +1270,7 @@ private:
     static const uint8_t GLITTER_B = 100; // Blue component of glitter
 
     static uint32_t lastGlitterTime = 0;
-    static bool glitterPositions[32] = {false}; // Track glitter state for all pixels (16 left + 16 right)
+    static uint32_t glitterPositions = 0; // Glitter bit per pixel (bits 0-15 left, 16-31 right)
     static const uint32_t GLITTER_UPDATE_INTERVAL = 100; // Update glitter every 100ms
     static const uint8_t GLITTER_CHANCE = 3; // 30% chance per update (out of 10)
 
@@ -761,9 +1281,13 @@ private:
     {
       lastGlitterTime = currentTime;
       
+      glitterPositions = 0;
       for (uint8_t i = 0; i < 32; i++)
       {
-        glitterPositions[i] = (random(0, 10) < GLITTER_CHANCE);
+        if (random(0, 10) < GLITTER_CHANCE)
+        {
+          glitterPositions |= (1UL << i);
+        }
       }
     }
 
@@ -781,7 +1305,7 @@ private:
         if (isHeartPixel)
         {
           // Check glitter for left eye
-          if (glitterPositions[pixelIndex])
+          if (glitterPositions & (1UL << pixelIndex))
           {
             frame.left[y][x] = {GLITTER_R, GLITTER_G, GLITTER_B};
           }
@@ -791,7 +1315,7 @@ private:
           }
           
           // Check glitter for right eye
-          if (glitterPositions[pixelIndex + 16])
+          if (glitterPositions & (1UL << (pixelIndex + 16)))
           {
             frame.right[y][x] = {GLITTER_R, GLITTER_G, GLITTER_B};
           }
@@ -809,24 +1333,37 @@ private:
     }
   }
 
-  static void renderRainbow(MaskFrame &frame)
+  static void renderRainbow(IndexedFrame &frame, bool relayout)
   {
     uint32_t currentTime = millis();
     uint8_t offset = (currentTime / 50) % 16; // Shift every 50ms, cycle through 16 positions
 
-    for (uint8_t y = 0; y < 4; y++)
+    // Pixel i always shows palette entry i; the animation rotates the palette
+    if (relayout)
     {
-      for (uint8_t x = 0; x < 4; x++)
+      for (uint8_t y = 0; y < 4; y++)
       {
-        uint8_t pixelIndex = (y * 4 + x + offset) % 16;
-        uint8_t r = (pixelIndex * 16) % 256;
-        uint8_t g = ((pixelIndex * 16 + 85) % 256);
-        uint8_t b = ((pixelIndex * 16 + 170) % 256);
-
-        frame.left[y][x] = {r, g, b};
-        frame.right[y][x] = {r, g, b};
+        for (uint8_t x = 0; x < 4; x++)
+        {
+          frame.setPixel(0, x, y, y * 4 + x);
+          frame.setPixel(1, x, y, y * 4 + x);
+        }
       }
     }
+
+    if (offset == frame.phase)
+      return;
+    frame.phase = offset;
+
+    for (uint8_t i = 0; i < 16; i++)
+    {
+      uint8_t colorIndex = (i + offset) % 16;
+      uint8_t r = (colorIndex * 16) % 256;
+      uint8_t g = ((colorIndex * 16 + 85) % 256);
+      uint8_t b = ((colorIndex * 16 + 170) % 256);
+
+      frame.palette[i] = {r, g, b};
+    }
   }
   static void renderMusic(MaskFrame &frame)
   {
@@ -868,7 +1405,7 @@ private:
     }
 
     // Define colors for each pillar
-    const RGB pillarColors[8] = {
+    static const RGB pillarColors[8] PROGMEM = {
         {255, 0, 0},   // Red
         {255, 127, 0}, // Orange
         {255, 255, 0}, // Yellow
@@ -882,64 +1419,50 @@ private:
     // Render pillars
     for (uint8_t side = 0; side < 2; side++)
     {
+      EyeBuffer &eye = side == 0 ? frame.left : frame.right;
+
       for (uint8_t col = 0; col < 4; col++)
       {
         uint8_t pillarIndex = side * 4 + col;
         uint8_t height = pillars[pillarIndex];
-        RGB color = pillarColors[pillarIndex];
+        RGB color = readProgmemColor(&pillarColors[pillarIndex]);
 
         for (uint8_t row = 0; row < 4; row++)
         {
           // Fill from bottom up based on height
           if ((3 - row) < height)
           {
-            if (side == 0)
-            {
-              frame.left[row][col] = color;
-            }
-            else
-            {
-              frame.right[row][col] = color;
-            }
+            eye[row][col] = color;
           }
           else
           {
-            if (side == 0)
-            {
-              frame.left[row][col] = {0, 0, 0};
-            }
-            else
-            {
-              frame.right[row][col] = {0, 0, 0};
-            }
+            eye[row][col] = {0, 0, 0};
           }
         }
       }
     }
   }
-  static void renderFlashing(MaskFrame &frame, uint8_t r = 255, uint8_t g = 255, uint8_t b = 255, uint32_t interval = 500)
+  static void renderFlashing(IndexedFrame &frame, bool relayout, uint8_t r = 255, uint8_t g = 255, uint8_t b = 255, uint32_t interval = 500)
   {
+    // Every pixel shows palette entry 0, which toggles between the color and off
+    if (relayout)
+    {
+      memset(frame.pixels, 0, sizeof(frame.pixels));
+    }
+
     uint32_t currentTime = millis();
     bool isOn = (currentTime / interval) % 2 == 0;
 
-    for (uint8_t y = 0; y < 4; y++)
+    if (isOn)
     {
-      for (uint8_t x = 0; x < 4; x++)
-      {
-        if (isOn)
-        {
-          frame.left[y][x] = {r, g, b};
-          frame.right[y][x] = {r, g, b};
-        }
-        else
-        {
-          frame.left[y][x] = {0, 0, 0};
-          frame.right[y][x] = {0, 0, 0};
-        }
-      }
+      frame.palette[0] = {r, g, b};
+    }
+    else
+    {
+      frame.palette[0] = {0, 0, 0};
     }
   }
-  static void renderDead(MaskFrame &frame)
+  static void renderDead(EyeBuffer &eye)
   {
     uint8_t r = 255;
     uint8_t g = 0;
@@ -957,12 +1480,11 @@ private:
           intensity = 255;
         }
 
-        frame.left[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
-        frame.right[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
+        eye[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
       }
     }
   }
-  static void renderCheck(MaskFrame &frame)
+  static void renderCheck(EyeBuffer &eye)
   {
     uint8_t r = 0;
     uint8_t g = 255;
@@ -981,12 +1503,11 @@ private:
           intensity = 255;
         }
 
-        frame.left[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
-        frame.right[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
+        eye[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
       }
     }
   }
-  static void renderBigEyes(MaskFrame &frame)
+  static void renderBigEyes(EyeBuffer &eye)
   {
     uint8_t r = 255;
     uint8_t g = 255;
@@ -1005,8 +1526,7 @@ private:
           intensity = 255;
         }
 
-        frame.left[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
-        frame.right[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
+        eye[y][x] = {(uint8_t)(r * intensity / 255), (uint8_t)(g * intensity / 255), (uint8_t)(b * intensity / 255)};
       }
     }
   }
@@ -1127,6 +1647,8 @@ private:
     // Render the matrix effect
     for (uint8_t side = 0; side < 2; side++)
     {
+      EyeBuffer &eye = side == 0 ? frame.left : frame.right;
+
       for (uint8_t col = 0; col < 4; col++)
       {
         uint8_t dropIndex = side * 4 + col;
@@ -1152,34 +1674,20 @@ private:
               }
             }
 
-            if (side == 0)
-            {
-              frame.left[row][col] = {0, intensity, 0};
-            }
-            else
-            {
-              frame.right[row][col] = {0, intensity, 0};
-            }
+            eye[row][col] = {0, intensity, 0};
           }
         }
         else
         {
           for (uint8_t row = 0; row < 4; row++)
           {
-            if (side == 0)
-            {
-              frame.left[row][col] = {0, 0, 0};
-            }
-            else
-            {
-              frame.right[row][col] = {0, 0, 0};
-            }
+            eye[row][col] = {0, 0, 0};
           }
         }
       }
     }
   }
-  static void renderLoading(MaskFrame &frame)
+  static void renderLoading(EyeBuffer &eye)
   {
     static uint32_t lastUpdateTime = 0;
     static uint8_t position = 0;
@@ -1196,7 +1704,7 @@ private:
     }
 
     // Define the edge path (clockwise around the perimeter) - 12 unique positions
-    const uint8_t edgePath[12][2] = {
+    static const uint8_t edgePath[12][2] PROGMEM = {
         {0, 0}, {0, 1}, {0, 2}, {0, 3}, // Top edge
         {1, 3},
         {2, 3},
@@ -1208,23 +1716,22 @@ private:
         {1, 0} // Left edge
     };
 
-    frame.clear();
+    memset(eye, 0, sizeof(EyeBuffer));
 
     // Render the loading pixel and trail
     for (uint8_t i = 0; i < TRAIL_LENGTH; i++)
     {
       uint8_t trailPos = (position + EDGE_PATH_LENGTH - i) % EDGE_PATH_LENGTH;
 
-      uint8_t row = edgePath[trailPos][0];
-      uint8_t col = edgePath[trailPos][1];
+      uint8_t row = pgm_read_byte(&edgePath[trailPos][0]);
+      uint8_t col = pgm_read_byte(&edgePath[trailPos][1]);
 
       uint8_t intensity = 255 - (i * 255 / TRAIL_LENGTH);
       uint8_t r = (255 * intensity) / 255;
       uint8_t g = (140 * intensity) / 255;
       uint8_t b = 0;
 
-      frame.left[row][col] = {r, g, b};
-      frame.right[row][col] = {r, g, b};
+      eye[row][col] = {r, g, b};
     }
   }
 };
@@ -1233,15 +1740,51 @@ private:
 // LED CONTROLLER
 // ============================================
 
+// Set DUAL_LANE_OUTPUT to 1 when the left and right panels are wired to
+// separate data pins (NEO_PIN and NEO_PIN_RIGHT). Both panels are then clocked
+// out together, one shared bit period per bit, which halves the time spent on
+// the wire with interrupts off. Both pins must be GPIO0-15.
+#ifndef DUAL_LANE_OUTPUT
+#define DUAL_LANE_OUTPUT 0
+#endif
+
+#if DUAL_LANE_OUTPUT
+// WS2812B bit timing in CPU cycles. Every bit starts with both lanes high,
+// lanes sending a 0 drop at T0H, lanes sending a 1 drop at T1H. host/wave_test
+// checks the resulting edges of both lanes against the datasheet windows.
+#define WS2812_T0H_CYCLES (F_CPU / 2500000)   // 0.40us
+#define WS2812_T1H_CYCLES (F_CPU / 1250000)   // 0.80us
+#define WS2812_BIT_CYCLES (F_CPU / 800000)    // 1.25us
+#define WS2812_LATCH_US 300                   // Low time that latches a frame
+#endif
+
 class LedController
 {
 public:
+#if DUAL_LANE_OUTPUT
+  LedController(uint8_t leftPin, uint8_t rightPin, uint16_t ledsPerSide)
+      : strip(ledsPerSide, leftPin, NEO_GRB + NEO_KHZ800),
+        stripRight(ledsPerSide, rightPin, NEO_GRB + NEO_KHZ800),
+        leftPinMask(1UL << leftPin),
+        rightPinMask(1UL << rightPin) {}
+#else
   LedController(uint8_t pin, uint16_t ledCount)
       : strip(ledCount, pin, NEO_GRB + NEO_KHZ800) {}
+#endif
 
   void begin()
   {
     strip.begin();
+#if DUAL_LANE_OUTPUT
+    stripRight.begin();
+#endif
+  }
+
+  void present(const IndexedFrame &frame)
+  {
+    MaskFrame expanded;
+    frame.expand(expanded);
+    present(expanded);
   }
 
   void present(const MaskFrame &frame)
@@ -1254,7 +1797,7 @@ public:
       {
         uint16_t idx = mapLeft(x, y);
         const RGB &color = correctedFrame.left[y][x];
-        strip.setPixelColor(idx, strip.Color(color.r, color.g, color.b));
+        setPixel(idx, color);
       }
     }
 
@@ -1264,11 +1807,15 @@ public:
       {
         uint16_t idx = mapRight(x, y);
         const RGB &color = correctedFrame.right[y][x];
-        strip.setPixelColor(idx, strip.Color(color.r, color.g, color.b));
+        setPixel(idx, color);
       }
     }
 
+#if DUAL_LANE_OUTPUT
+    showDualLane();
+#else
     strip.show();
+#endif
   }
 
   MaskFrame getCorrectedFrame(const MaskFrame &frame) const
@@ -1300,20 +1847,137 @@ public:
     return correctedFrame;
   }
 
-  void setBrightness(uint8_t brightness)
+  // The user's brightness, which Settings stores
+  void setBrightness(uint8_t level)
   {
-    strip.setBrightness(brightness);
+    brightness = level;
+    applyBrightness();
   }
 
   uint8_t getBrightness() const
+  {
+    return brightness;
+  }
+
+  // A running show drives the output level on its own, so its fades never
+  // change or persist the user's brightness
+  void setShowBrightness(uint8_t level)
+  {
+    showBrightness = level;
+    showBrightnessActive = true;
+    applyBrightness();
+  }
+
+  void clearShowBrightness()
+  {
+    if (!showBrightnessActive)
+      return;
+    showBrightnessActive = false;
+    applyBrightness();
+  }
+
+  // What the strip is driven at right now
+  uint8_t getOutputBrightness() const
   {
     return strip.getBrightness();
   }
 
+  void setOrientation(Orientation left, Orientation right)
+  {
+    orientation_L = left;
+    orientation_R = right;
+  }
+
+  Orientation getOrientationLeft() const
+  {
+    return orientation_L;
+  }
+
+  Orientation getOrientationRight() const
+  {
+    return orientation_R;
+  }
+
 private:
   Adafruit_NeoPixel strip;
+#if DUAL_LANE_OUTPUT
+  Adafruit_NeoPixel stripRight;
+  uint32_t leftPinMask;
+  uint32_t rightPinMask;
+  uint32_t lastShowTime = 0;
+#endif
   Orientation orientation_L = Orientation::NORMAL;
   Orientation orientation_R = Orientation::NORMAL;
+  uint8_t brightness = 255; // Unscaled until set, like the library
+  uint8_t showBrightness = 0;
+  bool showBrightnessActive = false;
+
+  void applyBrightness()
+  {
+    uint8_t level = showBrightnessActive ? showBrightness : brightness;
+    strip.setBrightness(level);
+#if DUAL_LANE_OUTPUT
+    stripRight.setBrightness(level);
+#endif
+  }
+
+  // Indices 0-15 are the left panel, 16-31 the right panel
+  void setPixel(uint16_t idx, const RGB &color)
+  {
+#if DUAL_LANE_OUTPUT
+    if (idx >= 16)
+    {
+      stripRight.setPixelColor(idx - 16, strip.Color(color.r, color.g, color.b));
+      return;
+    }
+#endif
+    strip.setPixelColor(idx, strip.Color(color.r, color.g, color.b));
+  }
+
+#if DUAL_LANE_OUTPUT
+  // Sends both strips' brightness-scaled GRB buffers at once, one byte of each
+  // per 8 bit periods
+  void IRAM_ATTR showDualLane()
+  {
+    while (micros() - lastShowTime < WS2812_LATCH_US)
+    {
+      yield();
+    }
+
+    const uint8_t *left = strip.getPixels();
+    const uint8_t *right = stripRight.getPixels();
+    const uint16_t byteCount = strip.numPixels() * 3;
+    const uint32_t bothMask = leftPinMask | rightPinMask;
+
+    noInterrupts();
+    uint32_t bitStart = ESP.getCycleCount() - WS2812_BIT_CYCLES;
+    for (uint16_t i = 0; i < byteCount; i++)
+    {
+      uint8_t leftByte = left[i];
+      uint8_t rightByte = right[i];
+      for (uint8_t bit = 0x80; bit != 0; bit >>= 1)
+      {
+        uint32_t zeroMask = ((leftByte & bit) ? 0 : leftPinMask) | ((rightByte & bit) ? 0 : rightPinMask);
+
+        while (ESP.getCycleCount() - bitStart < WS2812_BIT_CYCLES)
+          ;
+        bitStart = ESP.getCycleCount();
+        GPOS = bothMask;
+        while (ESP.getCycleCount() - bitStart < WS2812_T0H_CYCLES)
+          ;
+        GPOC = zeroMask;
+        while (ESP.getCycleCount() - bitStart < WS2812_T1H_CYCLES)
+          ;
+        GPOC = bothMask;
+      }
+    }
+    while (ESP.getCycleCount() - bitStart < WS2812_BIT_CYCLES)
+      ;
+    interrupts();
+
+    lastShowTime = micros();
+  }
+#endif
 
   // Convert row/col to zigzag wiring pattern index
   // Even rows (0, 2): left to right (0→1→2→3, 8→9→10→11)
@@ -1381,7 +2045,8 @@ namespace Core
 
     void setMode(Mode mode)
     {
-      if (currentMode != Mode::OFF)
+      // ERROR is never remembered, so toggling off and on again recovers from it
+      if (currentMode != Mode::OFF && currentMode != Mode::ERROR)
       {
         lastMode = currentMode;
       }
@@ -1442,15 +2107,21 @@ namespace Core
     uint32_t expressionTimer = 0;
     uint32_t nextExpressionTime = 0;
     bool expressionTaggedForChange = false;
+    uint32_t reactionTimeLeft = 0;
+    Expressions::Type reactionExpression = Expressions::Type::Neutral;
+    Expressions::Type reactionReturn = Expressions::Type::Neutral;
     Expressions::Type currentExpression;
     Expressions::Type quickExpression;
     MaskFrame *frame;
+    IndexedFrame *indexedFrame;
+    bool indexedFrameActive = false;
 
   public:
-    ExpressionManager(MaskFrame *frame)
+    ExpressionManager(MaskFrame *frame, IndexedFrame *indexedFrame = nullptr)
         : currentExpression(Expressions::Type::Neutral),
           quickExpression(Expressions::Type::Neutral),
-          frame(frame)
+          frame(frame),
+          indexedFrame(indexedFrame)
     {
       if (frame == nullptr)
       {
@@ -1542,7 +2213,24 @@ namespace Core
     }
 
     Expressions::Type getCurrentExpression() const { return currentExpression; }
+    // The expression a running reaction goes back to, else the current one
+    Expressions::Type getBaseExpression() const
+    {
+      return reactionTimeLeft > 0 && currentExpression == reactionExpression ? reactionReturn : currentExpression;
+    }
     Expressions::Type getQuickExpression() const { return quickExpression; }
+    void setQuickExpression(Expressions::Type type) { quickExpression = type; }
+
+    // Shows type for duration ms, then goes back to the expression it replaced
+    // unless something else changed the expression in the meantime
+    void react(Expressions::Type type, uint32_t duration)
+    {
+      if (reactionTimeLeft == 0)
+        reactionReturn = currentExpression;
+      reactionExpression = type;
+      reactionTimeLeft = duration;
+      currentExpression = type;
+    }
 
     void setForChange(uint32_t timeFromNow, uint32_t maxTime = 10000)
     {
@@ -1559,13 +2247,38 @@ namespace Core
 
     void updateFrame()
     {
-      if (frame != nullptr)
+      // Palette-animated expressions draw into the indexed frame when one is set
+      indexedFrameActive = indexedFrame != nullptr && Expressions::isIndexed(currentExpression);
+      if (indexedFrameActive)
+        Expressions::renderIndexed(currentExpression, *indexedFrame);
+      else if (frame != nullptr)
         Expressions::render(currentExpression, *frame);
     }
 
+    // True when the last updateFrame() drew into the indexed frame
+    bool isIndexedFrameActive() const
+    {
+      return indexedFrameActive;
+    }
+
     void update(uint32_t deltaTime)
     {
       expressionTimer += deltaTime;
+
+      if (reactionTimeLeft > 0)
+      {
+        if (deltaTime >= reactionTimeLeft)
+        {
+          reactionTimeLeft = 0;
+          if (currentExpression == reactionExpression)
+            currentExpression = reactionReturn;
+        }
+        else
+        {
+          reactionTimeLeft -= deltaTime;
+        }
+      }
+
       updateFrame();
 
       if (expressionTaggedForChange && expressionTimer >= nextExpressionTime)
@@ -1577,11 +2290,185 @@ namespace Core
   };
 }
 
+// ============================================
+// LATENCY PROBE
+// ============================================
+
+// Set LATENCY_MODE to 1 to time each button gesture from the first raw GPIO
+// edge, through the classified ButtonEvent and the resulting state change, to
+// the end of the strip.show() that first displays it. Send 'l' over serial for
+// the per-stage distributions. host/latency_test checks scripted gestures
+// against per-gesture budgets.
+#ifndef LATENCY_MODE
+#define LATENCY_MODE 0
+#endif
+#define LATENCY_TIMEOUT_US 2000000 // Drop gestures that never produce an event
+#define LATENCY_BUCKETS 12         // Power-of-two millisecond buckets: <1, <2, <4 ... >=1024
+
+class LatencyProbe
+{
+public:
+  enum Stage
+  {
+    EdgeToEvent,
+    EventToChange,
+    ChangeToPhoton,
+    EdgeToPhoton,
+    STAGE_COUNT
+  };
+
+  // Called from the GPIO interrupt; only the first edge of a gesture counts
+  void IRAM_ATTR markEdge()
+  {
+    if (!hasEdge)
+    {
+      edgeUs = micros();
+      hasEdge = true;
+    }
+  }
+
+  void markEvent()
+  {
+    if (!hasEdge || hasEvent)
+      return;
+    eventUs = micros();
+    hasEvent = true;
+    record(EdgeToEvent, eventUs - edgeUs);
+  }
+
+  void markChange()
+  {
+    if (!hasEvent || hasChange)
+      return;
+    changeUs = micros();
+    hasChange = true;
+    record(EventToChange, changeUs - eventUs);
+  }
+
+  // Call right after the frame has been sent to the LEDs
+  void markPresented()
+  {
+    uint32_t now = micros();
+
+    if (hasChange)
+    {
+      record(ChangeToPhoton, now - changeUs);
+      record(EdgeToPhoton, now - edgeUs);
+      reset();
+    }
+    else if (hasEvent)
+    {
+      reset(); // Event did not change anything visible
+    }
+    else if (hasEdge && now - edgeUs > LATENCY_TIMEOUT_US)
+    {
+      reset();
+    }
+  }
+
+  uint32_t getCount(Stage stage) const { return stages[stage].count; }
+  uint32_t getMaxUs(Stage stage) const { return stages[stage].maxUs; }
+
+  void printStats() const
+  {
+    Serial.println(F("# latency stage,count,min_us,avg_us,max_us,hist_ms(<1,<2,<4..>=1024)"));
+    for (uint8_t stage = 0; stage < STAGE_COUNT; stage++)
+    {
+      const StageStats &stats = stages[stage];
+      Serial.print(getStageName(stage));
+      Serial.print(',');
+      Serial.print(stats.count);
+      Serial.print(',');
+      Serial.print(stats.count ? stats.minUs : 0);
+      Serial.print(',');
+      Serial.print(stats.count ? static_cast<uint32_t>(stats.sumUs / stats.count) : 0);
+      Serial.print(',');
+      Serial.print(stats.maxUs);
+      for (uint8_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++)
+      {
+        Serial.print(bucket == 0 ? ',' : ' ');
+        Serial.print(stats.histogram[bucket]);
+      }
+      Serial.println();
+    }
+  }
+
+private:
+  struct StageStats
+  {
+    uint32_t count = 0;
+    uint32_t minUs = 0xFFFFFFFF;
+    uint32_t maxUs = 0;
+    uint64_t sumUs = 0;
+    uint16_t histogram[LATENCY_BUCKETS] = {};
+  };
+
+  volatile bool hasEdge = false;
+  volatile uint32_t edgeUs = 0;
+  bool hasEvent = false;
+  uint32_t eventUs = 0;
+  bool hasChange = false;
+  uint32_t changeUs = 0;
+  StageStats stages[STAGE_COUNT];
+
+  static const __FlashStringHelper *getStageName(uint8_t stage)
+  {
+    switch (stage)
+    {
+    case EdgeToEvent:
+      return F("edge>event");
+    case EventToChange:
+      return F("event>change");
+    case ChangeToPhoton:
+      return F("change>photon");
+    default:
+      return F("edge>photon");
+    }
+  }
+
+  void reset()
+  {
+    hasEvent = false;
+    hasChange = false;
+    hasEdge = false; // Last, this re-arms the interrupt side
+  }
+
+  void record(Stage stage, uint32_t us)
+  {
+    StageStats &stats = stages[stage];
+    stats.count++;
+    stats.sumUs += us;
+    if (us < stats.minUs)
+      stats.minUs = us;
+    if (us > stats.maxUs)
+      stats.maxUs = us;
+
+    uint8_t bucket = 0;
+    uint32_t ms = us / 1000;
+    while (ms > 0 && bucket < LATENCY_BUCKETS - 1)
+    {
+      ms >>= 1;
+      bucket++;
+    }
+    if (stats.histogram[bucket] < 0xFFFF)
+      stats.histogram[bucket]++;
+  }
+};
+
+#if LATENCY_MODE
+LatencyProbe latencyProbe;
+
+void IRAM_ATTR onButtonEdge()
+{
+  latencyProbe.markEdge();
+}
+#endif
+
 // ============================================
 // BUTTON HANDLER
 // ============================================
 
-#define MAX_BUTTONS 3
+#define MAX_BUTTONS 3 // Up to 8, buttons are tracked as bits of a uint8_t
 #define MAX_ACTIONS 12
 
 class ButtonHandler
@@ -1596,9 +2483,10 @@ public:
   };
 
   using ActionCallback = void (*)();
+  using EventObserver = void (*)(uint8_t buttonPin, ButtonEvent event);
 
   ButtonHandler(uint32_t doubleTapThreshold = 300, uint32_t holdThreshold = 500)
-      : doubleTapThreshold(doubleTapThreshold), holdThreshold(holdThreshold), debounceDelay(50)
+      : doubleTapThreshold(doubleTapThreshold), holdThreshold(holdThreshold)
   {
     for (int i = 0; i < MAX_ACTIONS; i++)
     {
@@ -1609,16 +2497,22 @@ public:
     for (int i = 0; i < MAX_BUTTONS; i++)
     {
       buttons[i].pin = 0xFF;
+      buttons[i].lastReleaseTime = doubleTapThreshold;
     }
   }
 
   void begin(uint8_t pin1, uint8_t pin2, uint8_t pin3)
   {
     uint8_t pins[] = {pin1, pin2, pin3};
+    begin(pins, 3);
+  }
 
-    for (int i = 0; i < MAX_BUTTONS; ++i)
+  void begin(const uint8_t *pins, uint8_t count)
+  {
+    for (int i = 0; i < MAX_BUTTONS && i < count; ++i)
     {
       buttons[i].pin = pins[i];
+      buttons[i].gpioMask = 1UL << pins[i]; // GPIO16 maps to bit 16, see readButtons()
       pinMode(pins[i], INPUT_PULLUP);
     }
   }
@@ -1640,7 +2534,15 @@ public:
 
   void update(uint32_t deltaTime)
   {
-    readButtons();
+    update(readButtons(), deltaTime);
+  }
+
+  // Runs one scan with the given raw levels (bit i set = button i pressed)
+  // instead of reading the GPIOs. Used to replay recorded input.
+  void update(uint8_t rawMask, uint32_t deltaTime)
+  {
+    lastRawMask = rawMask;
+    debounce(rawMask);
 
     for (int i = 0; i < MAX_BUTTONS; ++i)
     {
@@ -1649,8 +2551,6 @@ public:
       if (state.pin == 0xFF)
         continue;
 
-      state.lastChangeTime += deltaTime;
-
       if (state.isPressed)
       {
         state.pressTime += deltaTime;
@@ -1681,11 +2581,46 @@ public:
     return state->isPressed && state->pressTime >= holdThreshold;
   }
 
+  uint8_t getRawMask() const
+  {
+    return lastRawMask;
+  }
+
+  uint8_t getPin(uint8_t index) const
+  {
+    return index < MAX_BUTTONS ? buttons[index].pin : 0xFF;
+  }
+
+  // Called for every classified event before the registered actions run
+  void setEventObserver(EventObserver observer)
+  {
+    eventObserver = observer;
+  }
+
+  // Forget all debounce and gesture state, keeping pins and actions
+  void reset()
+  {
+    for (int i = 0; i < MAX_BUTTONS; ++i)
+    {
+      ButtonState &state = buttons[i];
+      state.isPressed = false;
+      state.pressTime = 0;
+      state.lastReleaseTime = doubleTapThreshold; // No recent tap to pair with
+      state.holdTriggered = false;
+      state.pendingTap = false;
+      state.combinationTriggered = false;
+    }
+    debouncedMask = 0;
+    counter0 = 0;
+    counter1 = 0;
+    lastRawMask = 0;
+  }
+
   uint8_t getHeldButtons() const
   {
     if (MAX_BUTTONS > 8)
     {
-      Serial.println("getHeldButtons() supports up to 8 buttons only.");
+      LOG_ERROR(LogEvent::TooManyButtons, MAX_BUTTONS);
       return 0;
     }
 
@@ -1705,12 +2640,11 @@ private:
   struct ButtonState
   {
     uint8_t pin = 0xFF;
+    uint32_t gpioMask = 0; // Bit of this pin in the sampled GPIO word
     bool isPressed = false;
-    bool lastPhysicalState = false;
     uint32_t pressTime = 0;
     uint32_t lastReleaseTime = 0;
     bool holdTriggered = false;
-    uint32_t lastChangeTime = 0;
     bool pendingTap = false;
     bool combinationTriggered = false;
   };
@@ -1726,7 +2660,14 @@ private:
   Action actions[MAX_ACTIONS] = {};
   uint32_t doubleTapThreshold;
   uint32_t holdThreshold;
-  uint32_t debounceDelay;
+
+  // Vertical debounce counters: bit i of (counter1, counter0) is a 2-bit count of
+  // consecutive scans in which button i differed from its debounced state
+  uint8_t debouncedMask = 0;
+  uint8_t counter0 = 0;
+  uint8_t counter1 = 0;
+  uint8_t lastRawMask = 0;
+  EventObserver eventObserver = nullptr;
 
   ButtonState *findButton(uint8_t buttonPin)
   {
@@ -1740,123 +2681,1443 @@ private:
     return nullptr;
   }
 
-  const ButtonState *findButton(uint8_t buttonPin) const
+  const ButtonState *findButton(uint8_t buttonPin) const
+  {
+    for (int i = 0; i < MAX_BUTTONS; ++i)
+    {
+      if (buttons[i].pin == buttonPin)
+      {
+        return &buttons[i];
+      }
+    }
+    return nullptr;
+  }
+
+  void triggerActions(uint8_t buttonPin, ButtonEvent event)
+  {
+    // Check if any OTHER button is currently held
+    for (int i = 0; i < MAX_BUTTONS; ++i)
+    {
+      if (buttons[i].pin != 0xFF && buttons[i].pin != buttonPin &&
+          buttons[i].isPressed && buttons[i].pressTime >= holdThreshold)
+      {
+        // Mark that held button as part of a combination
+        buttons[i].combinationTriggered = true;
+      }
+    }
+
+#if LATENCY_MODE
+    latencyProbe.markEvent();
+#endif
+
+    if (eventObserver)
+    {
+      eventObserver(buttonPin, event);
+    }
+
+    for (int i = 0; i < MAX_ACTIONS; ++i)
+    {
+      if (actions[i].buttonPin == buttonPin && actions[i].event == event)
+      {
+        if (actions[i].callback)
+        {
+          actions[i].callback();
+        }
+      }
+    }
+  }
+
+  // Samples every button with one GPIO register read
+  uint8_t readButtons() const
+  {
+    uint32_t gpio = GPI | ((GP16I & 0x01) << 16);
+
+    uint8_t rawMask = 0;
+    for (uint8_t i = 0; i < MAX_BUTTONS; ++i)
+    {
+      // LOW = pressed with INPUT_PULLUP
+      if (buttons[i].gpioMask != 0 && (gpio & buttons[i].gpioMask) == 0)
+      {
+        rawMask |= (1 << i);
+      }
+    }
+    return rawMask;
+  }
+
+  // Debounces all buttons at once: a button changes state after 4 consecutive
+  // scans that disagree with its debounced state. Only buttons with an edge are
+  // visited afterwards.
+  void debounce(uint8_t rawMask)
+  {
+    uint8_t delta = rawMask ^ debouncedMask;
+    counter1 = (counter1 ^ counter0) & delta;
+    counter0 = ~counter0 & delta;
+    uint8_t toggled = delta & ~(counter0 | counter1);
+    debouncedMask ^= toggled;
+
+    while (toggled)
+    {
+      uint8_t i = __builtin_ctz(toggled);
+      toggled &= toggled - 1;
+
+      ButtonState &state = buttons[i];
+      state.isPressed = (debouncedMask >> i) & 1;
+
+      if (state.isPressed) // BUTTON PRESSED
+      {
+        state.pressTime = 0;
+        state.holdTriggered = false;
+        state.combinationTriggered = false;
+        // Optional: triggerActions(state.pin, ButtonEvent::Press);
+      }
+      else // BUTTON RELEASED
+      {
+        if (!state.holdTriggered && state.pressTime < holdThreshold)
+        {
+          // It was a short press - check for double tap first
+          checkDoubleTap(state);
+        }
+
+        // Only trigger release event if button was held and no combination was performed
+        if (state.holdTriggered && !state.combinationTriggered)
+        {
+          triggerActions(state.pin, ButtonEvent::Release);
+        }
+
+        if (!state.holdTriggered && state.pressTime < holdThreshold)
+        {
+          state.lastReleaseTime = 0;
+        }
+      }
+    }
+  }
+
+  void checkDoubleTap(ButtonState &state)
+  {
+    if (state.lastReleaseTime > 0 && state.lastReleaseTime < doubleTapThreshold)
+    {
+      // This is the second tap - fire double-tap and cancel any pending single tap
+      triggerActions(state.pin, ButtonEvent::DoubleTap);
+      state.lastReleaseTime = doubleTapThreshold; // Prevent further taps
+      state.pendingTap = false;
+    }
+    else
+    {
+      // This is the first tap - mark it as pending and start the timer
+      state.lastReleaseTime = 0;
+      state.pendingTap = true;
+    }
+  }
+
+  void checkHold(ButtonState &state, uint32_t deltaTime)
+  {
+    if (!state.holdTriggered && state.pressTime >= holdThreshold)
+    {
+      triggerActions(state.pin, ButtonEvent::Hold);
+      state.holdTriggered = true;
+    }
+  }
+};
+
+// ============================================
+// INPUT TRACE
+// ============================================
+
+// Set INPUT_TRACE_MODE to 1 to record the raw button levels seen by
+// ButtonHandler and replay them later under a virtual clock. Serial commands:
+//   r - start recording (clears the trace)   s - stop recording
+//   d - dump the trace as hex                p - replay the trace
+//   u<hex>\n - upload a trace previously dumped with 'd'
+//
+// A trace is a list of 4-byte runs: raw mask, number of scans the mask was
+// held, and the total milliseconds of those scans (little endian).
+#ifndef INPUT_TRACE_MODE
+#define INPUT_TRACE_MODE 0
+#endif
+#define INPUT_TRACE_CAPACITY 128 // Runs, 4 bytes each
+
+class InputTrace
+{
+public:
+  void start()
+  {
+    length = 0;
+    recording = true;
+  }
+
+  void stop()
+  {
+    recording = false;
+  }
+
+  bool isRecording() const
+  {
+    return recording;
+  }
+
+  // Call once per scan with the mask ButtonHandler just used
+  void record(uint8_t rawMask, uint32_t deltaTime)
+  {
+    if (!recording)
+      return;
+
+    if (length > 0)
+    {
+      TraceRun &last = runs[length - 1];
+      if (last.mask == rawMask && last.scans < 0xFF && last.ms + deltaTime <= 0xFFFF)
+      {
+        last.scans++;
+        last.ms += deltaTime;
+        return;
+      }
+    }
+
+    if (length >= INPUT_TRACE_CAPACITY)
+    {
+      recording = false; // Full, keep what we have
+      return;
+    }
+
+    TraceRun &run = runs[length++];
+    run.mask = rawMask;
+    run.scans = 1;
+    run.ms = deltaTime > 0xFFFF ? 0xFFFF : deltaTime;
+  }
+
+  // Feeds the trace through the handler, spreading each run's time evenly over
+  // its scans. Returns the virtual duration in milliseconds.
+  uint32_t replay(ButtonHandler &handler)
+  {
+    virtualTime = 0;
+    handler.reset();
+
+    for (uint16_t i = 0; i < length; i++)
+    {
+      const TraceRun &run = runs[i];
+      if (run.scans == 0)
+        continue; // Malformed upload
+
+      uint16_t step = run.ms / run.scans;
+      uint16_t remainder = run.ms - step * run.scans;
+
+      for (uint8_t scan = 0; scan < run.scans; scan++)
+      {
+        uint32_t deltaTime = step + (scan == 0 ? remainder : 0);
+        virtualTime += deltaTime;
+        handler.update(run.mask, deltaTime);
+      }
+    }
+
+    handler.reset();
+    return virtualTime;
+  }
+
+  void dump() const
+  {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(runs);
+    for (uint16_t i = 0; i < length * sizeof(TraceRun); i++)
+    {
+      if (bytes[i] < 0x10)
+        Serial.print('0');
+      Serial.print(bytes[i], HEX);
+    }
+    Serial.println();
+  }
+
+  // Upload accepts the hex text produced by dump(), one character at a time
+  void beginUpload()
+  {
+    recording = false;
+    length = 0;
+    uploadNibbles = 0;
+  }
+
+  bool uploadHexChar(char c)
+  {
+    int value = hexValue(c);
+    uint16_t byteIndex = uploadNibbles / 2;
+    if (value < 0 || byteIndex >= sizeof(runs))
+      return false;
+
+    uint8_t *bytes = reinterpret_cast<uint8_t *>(runs);
+    if (uploadNibbles % 2 == 0)
+    {
+      bytes[byteIndex] = value << 4;
+    }
+    else
+    {
+      bytes[byteIndex] |= value;
+    }
+    uploadNibbles++;
+    return true;
+  }
+
+  void endUpload()
+  {
+    length = uploadNibbles / (2 * sizeof(TraceRun));
+  }
+
+  uint16_t getLength() const
+  {
+    return length;
+  }
+
+  // Virtual milliseconds into the current or last replay
+  uint32_t getReplayTime() const
+  {
+    return virtualTime;
+  }
+
+private:
+  struct TraceRun
+  {
+    uint8_t mask;
+    uint8_t scans;
+    uint16_t ms;
+  };
+
+  TraceRun runs[INPUT_TRACE_CAPACITY] = {};
+  uint16_t length = 0;
+  uint16_t uploadNibbles = 0;
+  uint32_t virtualTime = 0;
+  bool recording = false;
+
+  static int hexValue(char c)
+  {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+    return -1;
+  }
+};
+
+// ============================================
+// SETTINGS
+// ============================================
+
+// Settings are appended as fixed-size records to the flash sector reserved for
+// EEPROM emulation. The sector is only erased once it is full, so each erase
+// covers SETTINGS_RECORDS_PER_SECTOR saves. The erase blocks for tens of ms, so
+// it waits for an idle point after the write that filled the sector and then
+// writes the newest record back. On boot the newest record with a valid CRC wins.
+#define SETTINGS_SECTOR_SIZE 4096
+#define SETTINGS_SAVE_DELAY 5000 // ms without changes before writing to flash
+#define SETTINGS_MAGIC 0xA5
+
+extern "C" uint32_t _EEPROM_start;
+
+class Settings
+{
+public:
+  Settings(LedController &ledController, Core::ModeManager &modeManager, Core::ExpressionManager &expressionManager)
+      : ledController(ledController), modeManager(modeManager), expressionManager(expressionManager)
+  {
+  }
+
+  // Restores the newest stored settings. Returns false if nothing valid was found.
+  bool load()
+  {
+    nextSlot = 0;
+    bool found = false;
+    SettingsRecord record;
+
+    for (uint16_t slot = 0; slot < SETTINGS_RECORDS_PER_SECTOR; slot++)
+    {
+      if (!ESP.flashRead(slotAddress(slot), reinterpret_cast<uint32_t *>(&record), sizeof(record)))
+        break;
+
+      if (record.magic == 0xFF && record.crc == 0xFFFFFFFF)
+        break; // Erased space, end of log
+
+      nextSlot = slot + 1;
+      if (record.magic == SETTINGS_MAGIC && record.crc == computeCrc(record) &&
+          (!found || record.sequence > saved.sequence))
+      {
+        saved = record;
+        found = true;
+      }
+    }
+
+    if (found && isValid(saved))
+    {
+      apply(saved);
+    }
+    else
+    {
+      uint32_t sequence = found ? saved.sequence : 0; // Keep counting past a rejected record
+      found = false;
+      saved = capture();
+      saved.sequence = sequence;
+    }
+
+    pending = saved;
+    changeTimer = 0;
+    return found;
+  }
+
+  // While paused, update() neither tracks changes nor writes
+  void setPaused(bool value)
+  {
+    paused = value;
+  }
+
+  // Call every loop; writes once the state has been stable for SETTINGS_SAVE_DELAY.
+  // Returns true if this call blocked on a sector erase.
+  bool update(uint32_t deltaTime)
+  {
+    if (paused)
+      return false;
+
+    SettingsRecord current = capture();
+
+    if (!sameState(current, pending))
+    {
+      pending = current;
+      changeTimer = 0;
+      return false;
+    }
+
+    if (changeTimer < SETTINGS_SAVE_DELAY)
+    {
+      changeTimer += deltaTime;
+      return false;
+    }
+
+    if (!sameState(pending, saved))
+      return save(pending);
+
+    // Stable and saved: erase a full sector now instead of in front of the next save
+    if (nextSlot >= SETTINGS_RECORDS_PER_SECTOR)
+    {
+      changeTimer = 0; // On failure, retry after another SETTINGS_SAVE_DELAY
+      eraseSector();
+      return true;
+    }
+    return false;
+  }
+
+private:
+  struct SettingsRecord
+  {
+    uint8_t magic;
+    uint8_t brightness;
+    uint8_t expression;
+    uint8_t quickExpression;
+    uint8_t mode;
+    uint8_t orientationLeft;
+    uint8_t orientationRight;
+    uint8_t reserved;
+    uint32_t sequence;
+    uint32_t crc;
+  };
+
+  static const uint16_t SETTINGS_RECORDS_PER_SECTOR = SETTINGS_SECTOR_SIZE / sizeof(SettingsRecord);
+
+  LedController &ledController;
+  Core::ModeManager &modeManager;
+  Core::ExpressionManager &expressionManager;
+  SettingsRecord saved = {};
+  SettingsRecord pending = {};
+  uint16_t nextSlot = 0;
+  uint32_t changeTimer = 0;
+  bool paused = false;
+
+  static uint32_t sectorAddress()
+  {
+    return ((reinterpret_cast<uintptr_t>(&_EEPROM_start) - 0x40200000) / SETTINGS_SECTOR_SIZE) * SETTINGS_SECTOR_SIZE;
+  }
+
+  static uint32_t slotAddress(uint16_t slot)
+  {
+    return sectorAddress() + slot * sizeof(SettingsRecord);
+  }
+
+  static uint32_t computeCrc(const SettingsRecord &record)
+  {
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(&record);
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (uint8_t i = 0; i < sizeof(SettingsRecord) - sizeof(record.crc); i++) // crc is the last field
+    {
+      crc ^= data[i];
+      for (uint8_t bit = 0; bit < 8; bit++)
+      {
+        crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+      }
+    }
+    return ~crc;
+  }
+
+  static bool sameState(const SettingsRecord &a, const SettingsRecord &b)
+  {
+    return a.brightness == b.brightness && a.expression == b.expression &&
+           a.quickExpression == b.quickExpression && a.mode == b.mode &&
+           a.orientationLeft == b.orientationLeft && a.orientationRight == b.orientationRight;
+  }
+
+  static bool isValidExpression(uint8_t expression)
+  {
+    return expression < static_cast<uint8_t>(Expressions::Type::SIZE) &&
+           expression != static_cast<uint8_t>(Expressions::Type::NORMAL_EXPRESSION_END);
+  }
+
+  static bool isValid(const SettingsRecord &record)
+  {
+    return record.brightness > 0 &&
+           isValidExpression(record.expression) &&
+           isValidExpression(record.quickExpression) &&
+           record.mode <= static_cast<uint8_t>(Core::Mode::OFF) &&
+           record.orientationLeft <= static_cast<uint8_t>(Orientation::ROTATED_270) &&
+           record.orientationRight <= static_cast<uint8_t>(Orientation::ROTATED_270);
+  }
+
+  SettingsRecord capture() const
+  {
+    SettingsRecord record = {};
+    record.magic = SETTINGS_MAGIC;
+    record.brightness = ledController.getBrightness();
+    record.expression = static_cast<uint8_t>(expressionManager.getBaseExpression()); // Not a message or other reaction
+    record.quickExpression = static_cast<uint8_t>(expressionManager.getQuickExpression());
+    record.orientationLeft = static_cast<uint8_t>(ledController.getOrientationLeft());
+    record.orientationRight = static_cast<uint8_t>(ledController.getOrientationRight());
+
+    // Never persist ERROR, fall back to the mode we came from
+    Core::Mode mode = modeManager.isError() ? modeManager.getLastMode() : modeManager.getMode();
+    record.mode = static_cast<uint8_t>(mode);
+    return record;
+  }
+
+  void apply(const SettingsRecord &record)
+  {
+    ledController.setBrightness(record.brightness);
+    ledController.setOrientation(static_cast<Orientation>(record.orientationLeft),
+                                 static_cast<Orientation>(record.orientationRight));
+    expressionManager.setExpression(static_cast<Expressions::Type>(record.expression));
+    expressionManager.setQuickExpression(static_cast<Expressions::Type>(record.quickExpression));
+    modeManager.setMode(static_cast<Core::Mode>(record.mode));
+  }
+
+  // Returns true if the sector was still full and had to be erased first
+  bool save(SettingsRecord record)
+  {
+    changeTimer = 0;
+    bool erased = nextSlot >= SETTINGS_RECORDS_PER_SECTOR;
+    if (erased && !eraseSector())
+      return true;
+
+    record.sequence = saved.sequence + 1;
+    if (write(record))
+    {
+      saved = record;
+    }
+    return erased;
+  }
+
+  // Erases the sector and writes the saved record back as its first entry, so
+  // a reset before the next save still finds the newest settings
+  bool eraseSector()
+  {
+    if (!ESP.flashEraseSector(sectorAddress() / SETTINGS_SECTOR_SIZE))
+      return false;
+
+    nextSlot = 0;
+    write(saved);
+    return true;
+  }
+
+  bool write(SettingsRecord &record)
+  {
+    record.crc = computeCrc(record);
+
+    // Advance even on failure so a bad slot is skipped instead of retried forever
+    uint16_t slot = nextSlot++;
+    return ESP.flashWrite(slotAddress(slot), reinterpret_cast<uint32_t *>(&record), sizeof(record));
+  }
+};
+
+// ============================================
+// HEALTH MONITOR
+// ============================================
+
+#define HEALTH_FRAME_BUDGET_US 10000      // Work allowed per loop, excluding the idle delay
+#define HEALTH_MAX_CONSECUTIVE_OVERRUNS 50 // About half a second of overrunning frames
+#define HEALTH_MIN_FREE_HEAP 4096
+#define HEALTH_MIN_FREE_BLOCK 1024
+#define HEALTH_MIN_FREE_STACK 512
+#define HEALTH_WDT_TIMEOUT_MS 3000     // ESP8266 software watchdog, slightly rounded down
+#define HEALTH_MIN_WDT_MARGIN_MS 1000  // Trip if a loop gets closer than this to the timeout
+#define HEALTH_CHECK_INTERVAL_MS 1000  // How often heap and stack are sampled
+
+enum class HealthError : uint8_t
+{
+  None,
+  LoopOverrun,
+  LowHeap,
+  HeapFragmentation,
+  StackOverrun,
+  WatchdogMargin
+};
+
+// What a LogEvent::HealthStat record carries
+enum class HealthStat : uint8_t
+{
+  Error,
+  Overruns,
+  MaxWorkUs,
+  FreeHeap,
+  MinFreeHeap,
+  MaxFreeBlock,
+  FreeStack,
+  WdtMarginMs
+};
+
+class HealthMonitor
+{
+public:
+  HealthMonitor(Core::ModeManager &modeManager) : modeManager(modeManager) {}
+
+  void beginFrame()
+  {
+    uint32_t now = micros();
+    if (frameStart != 0)
+    {
+      uint32_t gapMs = (now - frameStart) / 1000;
+      if (gapMs > maxLoopGapMs)
+        maxLoopGapMs = gapMs;
+    }
+    frameStart = now;
+  }
+
+  // Leaves this frame's work time out of the overrun count, for known blocking
+  // work such as a flash erase
+  void excuseFrame()
+  {
+    frameExcused = true;
+  }
+
+  // Call after the frame has been presented, before the idle delay
+  void endFrame(uint32_t deltaTime)
+  {
+    // Leaving ERROR acknowledges the code, a fault that persists trips again
+    if (errorShown && !modeManager.isError())
+    {
+      error = HealthError::None;
+    }
+
+    uint32_t workTime = frameExcused ? 0 : micros() - frameStart;
+    frameExcused = false;
+    if (workTime > maxWorkTimeUs)
+      maxWorkTimeUs = workTime;
+
+    if (workTime > HEALTH_FRAME_BUDGET_US)
+    {
+      overrunCount++;
+      consecutiveOverruns++;
+    }
+    else
+    {
+      consecutiveOverruns = 0;
+    }
+
+    if (consecutiveOverruns >= HEALTH_MAX_CONSECUTIVE_OVERRUNS)
+    {
+      consecutiveOverruns = 0;
+      trip(HealthError::LoopOverrun);
+    }
+
+    checkTimer += deltaTime;
+    if (checkTimer >= HEALTH_CHECK_INTERVAL_MS)
+    {
+      checkTimer = 0;
+      checkResources();
+    }
+    errorShown = modeManager.isError();
+  }
+
+  HealthError getError() const
+  {
+    return error;
+  }
+
+  // Queues the stats as HealthStat log records, so they go out with the rest
+  // of the log as the UART has room instead of blocking the loop
+  void logStats() const
+  {
+    logStat(HealthStat::Error, static_cast<uint8_t>(error));
+    logStat(HealthStat::Overruns, overrunCount);
+    logStat(HealthStat::MaxWorkUs, maxWorkTimeUs);
+    logStat(HealthStat::FreeHeap, ESP.getFreeHeap());
+    logStat(HealthStat::MinFreeHeap, minFreeHeap);
+    logStat(HealthStat::MaxFreeBlock, ESP.getMaxFreeBlockSize());
+    logStat(HealthStat::FreeStack, ESP.getFreeContStack());
+    logStat(HealthStat::WdtMarginMs, maxLoopGapMs < HEALTH_WDT_TIMEOUT_MS ? HEALTH_WDT_TIMEOUT_MS - maxLoopGapMs : 0);
+  }
+
+private:
+  Core::ModeManager &modeManager;
+  HealthError error = HealthError::None;
+  uint32_t frameStart = 0;
+  uint32_t maxWorkTimeUs = 0;
+  uint32_t maxLoopGapMs = 0;
+  uint32_t overrunCount = 0;
+  uint16_t consecutiveOverruns = 0;
+  bool frameExcused = false;
+  bool errorShown = false; // ModeManager was in ERROR at the last endFrame()
+
+  // Asked for over serial, so not subject to LOG_LEVEL
+  static void logStat(HealthStat stat, uint32_t value)
+  {
+    logger.push(LogEvent::HealthStat, static_cast<uint8_t>(stat), value > 0xFFFF ? 0xFFFF : value);
+  }
+  uint32_t checkTimer = 0;
+  uint32_t minFreeHeap = 0xFFFFFFFF;
+
+  void checkResources()
+  {
+    uint32_t freeHeap = ESP.getFreeHeap();
+    if (freeHeap < minFreeHeap)
+      minFreeHeap = freeHeap;
+
+    if (freeHeap < HEALTH_MIN_FREE_HEAP)
+    {
+      trip(HealthError::LowHeap);
+    }
+    else if (ESP.getMaxFreeBlockSize() < HEALTH_MIN_FREE_BLOCK)
+    {
+      trip(HealthError::HeapFragmentation);
+    }
+    else if (ESP.getFreeContStack() < HEALTH_MIN_FREE_STACK)
+    {
+      trip(HealthError::StackOverrun);
+    }
+    else if (maxLoopGapMs + HEALTH_MIN_WDT_MARGIN_MS > HEALTH_WDT_TIMEOUT_MS)
+    {
+      maxLoopGapMs = 0;
+      trip(HealthError::WatchdogMargin);
+    }
+  }
+
+  void trip(HealthError newError)
+  {
+    error = newError;
+    LOG_ERROR(LogEvent::HealthError, static_cast<uint8_t>(newError));
+
+    if (!modeManager.isError() && !modeManager.isOff())
+    {
+      modeManager.setMode(Core::Mode::ERROR);
+    }
+  }
+};
+
+// ============================================
+// HEAD MOTION
+// ============================================
+
+// Set IMU_MODE to 1 when an MPU6050-class IMU is wired to IMU_SDA_PIN and
+// IMU_SCL_PIN. The sensor is read in two short I2C transactions (accel, then
+// gyro) on alternate loops, after the frame has been presented, so the bus
+// never delays LED output. Head pitch and yaw steer the Neutral gaze and a
+// sudden jerk shows Surprised for a moment.
+//
+// Axes assume the sensor is mounted flat with X pointing forward and Z up.
+// Keep the head still for the first IMU_CALIBRATION_SAMPLES samples.
+#ifndef IMU_MODE
+#define IMU_MODE 0
+#endif
+#define IMU_ADDRESS 0x68
+#define IMU_I2C_CLOCK 400000
+#define IMU_MAX_BUS_ERRORS 8         // Consecutive failed reads before giving up on the sensor
+#define IMU_CALIBRATION_SAMPLES 32   // Gyro bias and level pitch averaging at startup
+#define IMU_MAX_SAMPLE_MS 100        // Longer gaps are clamped so a stall can't fling the angles
+#define IMU_GAZE_DEADZONE 1500       // Centidegrees of pitch or yaw before the eyes follow
+#define IMU_JERK_THRESHOLD 12000     // Summed accel change between samples, 16384 = 1g
+#define IMU_JERK_COOLDOWN_MS 3000
+#define IMU_REACTION_MS 1500         // How long Surprised is shown after a jerk
+
+// One raw sensor reading, MPU6050 default ranges
+struct MotionSample
+{
+  int16_t accel[3]; // X, Y, Z, 16384 = 1g
+  int16_t gyro[3];  // X, Y, Z, 131 = 1 deg/s
+};
+
+class HeadMotion
+{
+public:
+  // Wakes the sensor. Returns false if nothing answers at IMU_ADDRESS.
+  bool begin(uint8_t sdaPin, uint8_t sclPin)
+  {
+    Wire.begin(sdaPin, sclPin);
+    Wire.setClock(IMU_I2C_CLOCK);
+
+    // Clones report different WHO_AM_I values, so only require an answer
+    uint8_t whoAmI = 0;
+    connected = readRegisters(REG_WHO_AM_I, &whoAmI, 1) &&
+                writeRegister(REG_PWR_MGMT_1, 0x01); // Wake up, clock from gyro X PLL
+    if (!connected)
+    {
+      LOG_ERROR(LogEvent::ImuMissing, IMU_ADDRESS);
+    }
+    return connected;
+  }
+
+  // Runs one bus step per call; every second call completes a sample
+  void update(uint32_t deltaTime)
+  {
+    if (!connected)
+      return;
+
+    sampleTime += deltaTime;
+
+    uint8_t raw[6];
+    uint8_t reg = readingGyro ? REG_GYRO_XOUT_H : REG_ACCEL_XOUT_H;
+    if (!readRegisters(reg, raw, sizeof(raw)))
+    {
+      if (++busErrors >= IMU_MAX_BUS_ERRORS)
+      {
+        connected = false;
+        LOG_ERROR(LogEvent::ImuMissing, IMU_ADDRESS);
+      }
+      return;
+    }
+    busErrors = 0;
+
+    int16_t *axes = readingGyro ? sample.gyro : sample.accel;
+    for (uint8_t i = 0; i < 3; i++)
+    {
+      axes[i] = static_cast<int16_t>((raw[i * 2] << 8) | raw[i * 2 + 1]);
+    }
+
+    if (readingGyro)
+    {
+      feed(sample, sampleTime);
+      sampleTime = 0;
+    }
+    readingGyro = !readingGyro;
+  }
+
+  // Runs the filter on one complete sample taken deltaTime ms after the last
+  void feed(const MotionSample &sample, uint32_t deltaTime)
+  {
+    int32_t accelPitch = atan2Centidegrees(-sample.accel[0], sample.accel[2]);
+
+    if (calibrationCount < IMU_CALIBRATION_SAMPLES)
+    {
+      for (uint8_t i = 0; i < 3; i++)
+      {
+        gyroBias[i] += sample.gyro[i];
+      }
+      levelPitch += accelPitch;
+
+      if (++calibrationCount == IMU_CALIBRATION_SAMPLES)
+      {
+        for (uint8_t i = 0; i < 3; i++)
+        {
+          gyroBias[i] /= IMU_CALIBRATION_SAMPLES;
+        }
+        levelPitch /= IMU_CALIBRATION_SAMPLES;
+        pitch = levelPitch;
+      }
+      memcpy(lastAccel, sample.accel, sizeof(lastAccel));
+      return;
+    }
+
+    if (deltaTime > IMU_MAX_SAMPLE_MS)
+      deltaTime = IMU_MAX_SAMPLE_MS;
+
+    // 131 LSB per deg/s integrated over deltaTime ms, in centidegrees
+    int32_t pitchDelta = (sample.gyro[1] - gyroBias[1]) * 100 * static_cast<int32_t>(deltaTime) / 131000;
+    int32_t yawDelta = (sample.gyro[2] - gyroBias[2]) * 100 * static_cast<int32_t>(deltaTime) / 131000;
+
+    // Complementary filter: gyro for fast motion, accel pulls pitch back to true.
+    // Yaw has no absolute reference, so it leaks back to centre instead.
+    pitch = ((pitch + pitchDelta) * 250 + accelPitch * 6) / 256;
+    yaw = (yaw + yawDelta) * 255 / 256;
+
+    uint32_t accelChange = 0;
+    for (uint8_t i = 0; i < 3; i++)
+    {
+      accelChange += abs(sample.accel[i] - lastAccel[i]);
+    }
+    memcpy(lastAccel, sample.accel, sizeof(lastAccel));
+
+    jerkCooldown = jerkCooldown > deltaTime ? jerkCooldown - deltaTime : 0;
+    if (accelChange > IMU_JERK_THRESHOLD && jerkCooldown == 0)
+    {
+      jerkDetected = true;
+      jerkCooldown = IMU_JERK_COOLDOWN_MS;
+    }
+  }
+
+  // Look direction for Expressions::setGaze, as seen by someone facing the
+  // mask, or -1 while the head is near level and centred or the sensor is lost
+  int8_t getGazeDirection() const
+  {
+    // Indexed by [pitch up/level/down][yaw right/centre/left] of the wearer
+    static const int8_t GAZE_DIRECTIONS[9] PROGMEM = {
+        7, 3, 6,
+        1, -1, 0,
+        5, 2, 4};
+
+    if (!connected || calibrationCount < IMU_CALIBRATION_SAMPLES)
+      return -1;
+
+    int32_t relativePitch = pitch - levelPitch;
+    uint8_t row = relativePitch < -IMU_GAZE_DEADZONE ? 0 : (relativePitch > IMU_GAZE_DEADZONE ? 2 : 1);
+    uint8_t col = yaw < -IMU_GAZE_DEADZONE ? 0 : (yaw > IMU_GAZE_DEADZONE ? 2 : 1);
+    return static_cast<int8_t>(pgm_read_byte(&GAZE_DIRECTIONS[row * 3 + col]));
+  }
+
+  // True once per detected jerk
+  bool takeJerk()
+  {
+    bool jerk = jerkDetected;
+    jerkDetected = false;
+    return jerk;
+  }
+
+  bool isConnected() const { return connected; }
+  int32_t getPitch() const { return pitch - levelPitch; }
+  int32_t getYaw() const { return yaw; }
+
+  void printStats() const
+  {
+    Serial.println(F("# imu"));
+    Serial.print(F("connected="));
+    Serial.println(connected ? 1 : 0);
+    Serial.print(F("calibrated="));
+    Serial.println(calibrationCount >= IMU_CALIBRATION_SAMPLES ? 1 : 0);
+    Serial.print(F("bus_errors="));
+    Serial.println(busErrors);
+    Serial.print(F("pitch_cdeg="));
+    Serial.println(getPitch());
+    Serial.print(F("yaw_cdeg="));
+    Serial.println(yaw);
+    Serial.print(F("gaze="));
+    Serial.println(getGazeDirection());
+  }
+
+private:
+  static const uint8_t REG_ACCEL_XOUT_H = 0x3B;
+  static const uint8_t REG_GYRO_XOUT_H = 0x43;
+  static const uint8_t REG_PWR_MGMT_1 = 0x6B;
+  static const uint8_t REG_WHO_AM_I = 0x75;
+
+  bool connected = false;
+  bool readingGyro = false;
+  bool jerkDetected = false;
+  uint8_t busErrors = 0;
+  uint8_t calibrationCount = 0;
+  uint32_t sampleTime = 0;
+  uint32_t jerkCooldown = 0;
+  MotionSample sample = {};
+  int16_t lastAccel[3] = {};
+  int32_t gyroBias[3] = {};
+  int32_t levelPitch = 0; // Centidegrees
+  int32_t pitch = 0;      // Centidegrees, positive nose down
+  int32_t yaw = 0;        // Centidegrees, positive turning left
+
+  bool writeRegister(uint8_t reg, uint8_t value)
+  {
+    Wire.beginTransmission(IMU_ADDRESS);
+    Wire.write(reg);
+    Wire.write(value);
+    return Wire.endTransmission() == 0;
+  }
+
+  bool readRegisters(uint8_t reg, uint8_t *data, uint8_t count)
+  {
+    Wire.beginTransmission(IMU_ADDRESS);
+    Wire.write(reg);
+    if (Wire.endTransmission(false) != 0)
+      return false;
+    if (Wire.requestFrom(static_cast<uint8_t>(IMU_ADDRESS), count) != count)
+      return false;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+      data[i] = Wire.read();
+    }
+    return true;
+  }
+
+  // atan2 in centidegrees, within about 0.3 degrees, without floating point
+  static int32_t atan2Centidegrees(int32_t y, int32_t x)
+  {
+    if (x == 0 && y == 0)
+      return 0;
+
+    int32_t absX = abs(x);
+    int32_t absY = abs(y);
+    bool steep = absY > absX;
+    int32_t ratio = steep ? (absX << 10) / absY : (absY << 10) / absX; // 0..1024
+
+    // atan(r) ~ 45r + 15.64r(1 - r) degrees for 0 <= r <= 1
+    int32_t angle = (4500 * ratio + 1564 * ratio * (1024 - ratio) / 1024) / 1024;
+    if (steep)
+      angle = 9000 - angle;
+    if (x < 0)
+      angle = 18000 - angle;
+    return y < 0 ? -angle : angle;
+  }
+};
+
+// ============================================
+// SEQUENCER
+// ============================================
+
+// Plays a cue list: timestamped expression changes, crossfades and brightness
+// ramps, with labels and loops, kept in flash as 8-byte records. The show clock
+// only runs in ACTIVE mode and can be paused, seeked and resynced. Due cues go
+// into a small queue that loop() drains; the cursor only ever looks at the next
+// cue. Ramps drive LedController's show brightness, not the user's, and the
+// output goes back to the user's brightness once the show has played out.
+//
+// While a show runs, button 1 tap pauses/resumes, button 2 tap resyncs (jumps
+// the clock to the next cue so it fires now) and button 1 double tap stops.
+// Over serial: 'q' start/stop, 'z' pause/resume, 'y' resync, 'k<ms>\n' seek.
+#define SEQUENCER_AUTOSTART 0   // Start SHOWS[0] at boot
+#define SEQUENCER_QUEUE_SIZE 8  // Pending cues, must be a power of two
+#define SEQUENCER_MAX_LABELS 8
+
+enum class CueOp : uint8_t
+{
+  Expression, // arg0 = Expressions::Type
+  Transition, // arg0 = Expressions::Type, arg1 = crossfade time in ms
+  Brightness, // arg0 = target level, arg1 = ramp time in ms
+  Label,      // arg0 = label id, marks a loop start
+  Loop,       // arg0 = label id, arg1 = times to jump back (0 = forever)
+  End,        // Stops the show
+  COUNT
+};
+
+struct Cue
+{
+  uint32_t time; // ms from show start, never decreasing along the list
+  uint8_t op;    // CueOp
+  uint8_t arg0;
+  uint16_t arg1;
+};
+
+#define CUE_EXPRESSION(time, type) {time, static_cast<uint8_t>(CueOp::Expression), static_cast<uint8_t>(Expressions::Type::type), 0}
+#define CUE_TRANSITION(time, type, fadeMs) {time, static_cast<uint8_t>(CueOp::Transition), static_cast<uint8_t>(Expressions::Type::type), fadeMs}
+#define CUE_BRIGHTNESS(time, level, rampMs) {time, static_cast<uint8_t>(CueOp::Brightness), level, rampMs}
+#define CUE_LABEL(time, label) {time, static_cast<uint8_t>(CueOp::Label), label, 0}
+#define CUE_LOOP(time, label, repeats) {time, static_cast<uint8_t>(CueOp::Loop), label, repeats}
+#define CUE_END(time) {time, static_cast<uint8_t>(CueOp::End), 0, 0}
+
+struct Show
+{
+  const Cue *cues; // In PROGMEM
+  uint16_t count;
+};
+
+class Sequencer
+{
+public:
+  // Checks the cue list and starts it from time 0. Returns false and leaves
+  // the sequencer stopped if the list is malformed.
+  bool start(const Show &newShow)
+  {
+    stop();
+
+    for (uint8_t i = 0; i < SEQUENCER_MAX_LABELS; i++)
+      labelCursor[i] = NO_LABEL;
+
+    uint32_t lastTime = 0;
+    for (uint16_t i = 0; i < newShow.count; i++)
+    {
+      Cue cue = readCue(newShow, i);
+      if (cue.time < lastTime || cue.op >= static_cast<uint8_t>(CueOp::COUNT))
+        return false;
+      lastTime = cue.time;
+
+      switch (static_cast<CueOp>(cue.op))
+      {
+      case CueOp::Expression:
+      case CueOp::Transition:
+        if (cue.arg0 >= static_cast<uint8_t>(Expressions::Type::SIZE) ||
+            cue.arg0 == static_cast<uint8_t>(Expressions::Type::NORMAL_EXPRESSION_END))
+          return false;
+        break;
+      case CueOp::Label:
+        if (cue.arg0 >= SEQUENCER_MAX_LABELS)
+          return false;
+        labelCursor[cue.arg0] = i;
+        break;
+      case CueOp::Loop:
+        if (cue.arg0 >= SEQUENCER_MAX_LABELS || labelCursor[cue.arg0] == NO_LABEL)
+          return false; // Loops may only jump back to a label already seen
+        if (cue.time <= readCue(newShow, labelCursor[cue.arg0]).time)
+          return false; // A zero-length loop would never let the clock move on
+        break;
+      default:
+        break;
+      }
+    }
+
+    show = newShow;
+    running = true;
+    ending = false;
+    seek(0);
+    return true;
+  }
+
+  void stop()
+  {
+    running = false;
+    paused = false;
+    ending = false;
+    rampActive = false;
+    transitionActive = false;
+    head = tail = 0;
+  }
+
+  void togglePause()
+  {
+    if (running)
+      paused = !paused;
+  }
+
+  // Moves the show clock to time, cues before it are not replayed. Loop
+  // counters restart, so time is taken as within the first pass.
+  void seek(uint32_t time)
+  {
+    if (!running)
+      return;
+
+    // First cue at or after time
+    uint16_t low = 0;
+    uint16_t high = show.count;
+    while (low < high)
+    {
+      uint16_t mid = low + (high - low) / 2;
+      if (readCue(show, mid).time < time)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+
+    cursor = low;
+    clock = time;
+    rampActive = false;
+    transitionActive = false;
+    head = tail = 0;
+    memset(loopCount, 0, sizeof(loopCount));
+  }
+
+  // Jumps the clock to the next cue so it fires on this frame. lateBy is how
+  // long ago the cue should have fired, e.g. the button tap delay.
+  void resync(uint32_t lateBy = 0)
+  {
+    if (!running)
+      return;
+
+    paused = false;
+    if (cursor < show.count)
+      clock = readCue(show, cursor).time + lateBy;
+  }
+
+  // Advances the show clock and queues every cue that has come due. Fades
+  // keep running after the show ends so the last one still completes.
+  void update(uint32_t deltaTime)
+  {
+    if (paused)
+      return;
+
+    if (rampActive)
+      rampElapsed += deltaTime;
+    if (transitionActive)
+    {
+      transitionElapsed += deltaTime;
+      if (transitionElapsed >= transitionDuration)
+        transitionActive = false;
+    }
+
+    if (!running)
+    {
+      // Everything queued before End has played out
+      if (ending && tail == head && !rampActive && !transitionActive)
+        ending = false;
+      return;
+    }
+
+    clock += deltaTime;
+
+    while (running && cursor < show.count)
+    {
+      Cue cue = readCue(show, cursor);
+      if (cue.time > clock)
+        break;
+
+      switch (static_cast<CueOp>(cue.op))
+      {
+      case CueOp::Label:
+        break;
+      case CueOp::Loop:
+        if (cue.arg1 == 0 || loopCount[cue.arg0] < cue.arg1)
+        {
+          loopCount[cue.arg0]++;
+          uint16_t target = labelCursor[cue.arg0];
+          clock = readCue(show, target).time + (clock - cue.time);
+          cursor = target + 1;
+          continue;
+        }
+        loopCount[cue.arg0] = 0; // Ready for the next time this loop is reached
+        break;
+      case CueOp::End:
+        finish();
+        continue;
+      default:
+        if (!push(cue))
+          return; // Queue full, retry this cue next frame
+        break;
+      }
+      cursor++;
+    }
+
+    if (running && cursor >= show.count)
+      finish();
+  }
+
+  // Pops the next due cue, returns false when none are waiting
+  bool poll(Cue &cue)
+  {
+    if (tail == head)
+      return false;
+
+    cue = queue[tail];
+    tail = (tail + 1) & (SEQUENCER_QUEUE_SIZE - 1);
+    return true;
+  }
+
+  // Starts a brightness ramp on the show clock; the ramp pauses with the show.
+  // Ignored once the show is stopped, except for cues queued before its end.
+  void startRamp(uint8_t from, uint8_t to, uint16_t duration)
+  {
+    if (!running && !ending)
+      return;
+
+    rampFrom = from;
+    rampTo = to;
+    rampDuration = duration;
+    rampElapsed = 0;
+    rampActive = true;
+  }
+
+  // Starts a crossfade from the frame shown before a Transition cue. Like the
+  // ramp it runs on the show clock and is ignored once the show is stopped.
+  void startTransition(uint16_t duration)
+  {
+    if ((!running && !ending) || duration == 0)
+      return;
+
+    transitionDuration = duration;
+    transitionElapsed = 0;
+    transitionActive = true;
+  }
+
+  // How far the crossfade is, 0 = old frame to 255 = new expression; false
+  // when none is running
+  bool getTransitionMix(uint8_t &mix) const
   {
-    for (int i = 0; i < MAX_BUTTONS; ++i)
-    {
-      if (buttons[i].pin == buttonPin)
-      {
-        return &buttons[i];
-      }
-    }
-    return nullptr;
+    if (!transitionActive)
+      return false;
+
+    mix = transitionElapsed * 255 / transitionDuration;
+    return true;
   }
 
-  void triggerActions(uint8_t buttonPin, ButtonEvent event)
+  // Current ramp level, false when no ramp is running
+  bool getRampLevel(uint8_t &level)
   {
-    // Check if any OTHER button is currently held
-    for (int i = 0; i < MAX_BUTTONS; ++i)
+    if (!rampActive)
+      return false;
+
+    if (rampElapsed >= rampDuration)
     {
-      if (buttons[i].pin != 0xFF && buttons[i].pin != buttonPin &&
-          buttons[i].isPressed && buttons[i].pressTime >= holdThreshold)
-      {
-        // Mark that held button as part of a combination
-        buttons[i].combinationTriggered = true;
-      }
+      level = rampTo;
+      rampActive = false;
     }
-
-    for (int i = 0; i < MAX_ACTIONS; ++i)
+    else
     {
-      if (actions[i].buttonPin == buttonPin && actions[i].event == event)
-      {
-        if (actions[i].callback)
-        {
-          actions[i].callback();
-        }
-      }
+      level = rampFrom + (static_cast<int32_t>(rampTo) - rampFrom) * static_cast<int32_t>(rampElapsed) / rampDuration;
     }
+    return true;
   }
 
-  void readButtons()
+  bool isRunning() const { return running; }
+  bool isPaused() const { return paused; }
+  // Stopped, with nothing queued or fading
+  bool isIdle() const { return !running && !ending && !rampActive && !transitionActive; }
+  uint32_t getClock() const { return clock; }
+
+private:
+  static const uint16_t NO_LABEL = 0xFFFF;
+
+  Show show = {nullptr, 0};
+  bool running = false;
+  bool paused = false;
+  bool ending = false; // Reached End, queued cues and the ramp still play out
+  uint16_t cursor = 0;
+  uint32_t clock = 0;
+  uint16_t labelCursor[SEQUENCER_MAX_LABELS] = {};
+  uint16_t loopCount[SEQUENCER_MAX_LABELS] = {};
+
+  Cue queue[SEQUENCER_QUEUE_SIZE] = {};
+  uint8_t head = 0;
+  uint8_t tail = 0;
+
+  bool rampActive = false;
+  uint8_t rampFrom = 0;
+  uint8_t rampTo = 0;
+  uint16_t rampDuration = 0;
+  uint32_t rampElapsed = 0;
+
+  bool transitionActive = false;
+  uint16_t transitionDuration = 0;
+  uint32_t transitionElapsed = 0;
+
+  // Ends the show but leaves already queued cues and the fades to finish
+  void finish()
   {
-    for (int i = 0; i < MAX_BUTTONS; ++i)
-    {
-      ButtonState &state = buttons[i];
-      if (state.pin == 0xFF)
-        continue;
+    running = false;
+    paused = false;
+    ending = true;
+  }
 
-      bool physicalState = (digitalRead(state.pin) == LOW);
+  static Cue readCue(const Show &show, uint16_t index)
+  {
+    Cue cue;
+    memcpy_P(&cue, &show.cues[index], sizeof(Cue));
+    return cue;
+  }
 
-      // 1. Detect physical movement to reset the debounce timer
-      if (physicalState != state.lastPhysicalState)
-      {
-        state.lastPhysicalState = physicalState;
-        state.lastChangeTime = 0;
-      }
+  bool push(const Cue &cue)
+  {
+    uint8_t next = (head + 1) & (SEQUENCER_QUEUE_SIZE - 1);
+    if (next == tail)
+      return false;
 
-      // 2. Only proceed if the signal has been stable for 'debounceDelay' ms
-      if (state.lastChangeTime >= debounceDelay)
-      {
-        // 3. Check if the stable state is different from our registered state
-        if (physicalState != state.isPressed)
-        {
-          state.isPressed = physicalState;
+    queue[head] = cue;
+    head = next;
+    return true;
+  }
+};
 
-          if (state.isPressed) // BUTTON PRESSED
-          {
-            state.pressTime = 0;
-            state.holdTriggered = false;
-            state.combinationTriggered = false;
-            // Optional: triggerActions(state.pin, ButtonEvent::Press);
-          }
-          else // BUTTON RELEASED
-          {
-            if (!state.holdTriggered && state.pressTime < holdThreshold)
-            {
-              // It was a short press - check for double tap first
-              checkDoubleTap(state);
-            }
+// Demo show: fade in, cycle three expressions twice, fade through Dead and
+// crossfade back to Neutral
+static const Cue DEMO_SHOW[] PROGMEM = {
+    CUE_EXPRESSION(0, Neutral),
+    CUE_BRIGHTNESS(0, 40, 1000),
+    CUE_LABEL(1000, 0),
+    CUE_EXPRESSION(1000, Happy),
+    CUE_EXPRESSION(2000, Surprised),
+    CUE_EXPRESSION(3000, Wink),
+    CUE_LOOP(4000, 0, 1),
+    CUE_BRIGHTNESS(4000, 1, 1500),
+    CUE_EXPRESSION(5500, Dead),
+    CUE_BRIGHTNESS(5500, 40, 500),
+    CUE_TRANSITION(8000, Neutral, 600),
+    CUE_END(8000)};
+
+static const Show SHOWS[] = {
+    {DEMO_SHOW, sizeof(DEMO_SHOW) / sizeof(DEMO_SHOW[0])}};
 
-            // Only trigger release event if button was held and no combination was performed
-            if (state.holdTriggered && !state.combinationTriggered)
-            {
-              triggerActions(state.pin, ButtonEvent::Release);
-            }
+// ============================================
+// BENCHMARK
+// ============================================
 
-            if (!state.holdTriggered && state.pressTime < holdThreshold)
-            {
-              state.lastReleaseTime = 0;
-            }
-          }
-        }
+// Set BENCHMARK_MODE to 1 to time every renderer, the present path and the
+// button state machine once at boot. Results are printed over serial as CSV
+// (one "bench," line per case) so runs can be saved and diffed. host/bench.cpp
+// runs the same cases on the host against a committed baseline and prints the
+// same columns. allocs is only counted on the host, where operator new is
+// hooked; the device leaves it empty and heap_delta shows what was kept.
+#define BENCHMARK_MODE 0
+#define BENCHMARK_ITERATIONS 200
+#define BENCHMARK_TICK_MS 10 // Virtual clock step fed to ButtonHandler::update
+
+class Benchmark
+{
+public:
+  static void runAll(LedController &ledController, ButtonHandler &buttonHandler)
+  {
+    MaskFrame frame;
+    frame.clear();
+
+    Serial.println();
+    Serial.print(F("# bench v2 cpu_mhz="));
+    Serial.print(ESP.getCpuFreqMHz());
+    Serial.print(F(" iterations="));
+    Serial.println(BENCHMARK_ITERATIONS);
+    Serial.println(F("bench,case,cycles_per_iter,ns_per_iter,heap_delta,allocs"));
+
+    for (int i = 0; i < static_cast<int>(Expressions::Type::SIZE); i++)
+    {
+      Expressions::Type type = static_cast<Expressions::Type>(i);
+      if (type == Expressions::Type::NORMAL_EXPRESSION_END)
+        continue;
+
+      uint32_t heapBefore = ESP.getFreeHeap();
+      uint32_t start = ESP.getCycleCount();
+      for (uint16_t n = 0; n < BENCHMARK_ITERATIONS; n++)
+      {
+        Expressions::render(type, frame);
       }
+      uint32_t cycles = ESP.getCycleCount() - start;
+      report(F("render"), Expressions::getName(type), cycles, heapBefore);
     }
-  }
 
-  void checkDoubleTap(ButtonState &state)
-  {
-    if (state.lastReleaseTime > 0 && state.lastReleaseTime < doubleTapThreshold)
+    uint32_t heapBefore = ESP.getFreeHeap();
+    uint32_t start = ESP.getCycleCount();
+    for (uint16_t n = 0; n < BENCHMARK_ITERATIONS; n++)
     {
-      // This is the second tap - fire double-tap and cancel any pending single tap
-      triggerActions(state.pin, ButtonEvent::DoubleTap);
-      state.lastReleaseTime = doubleTapThreshold; // Prevent further taps
-      state.pendingTap = false;
+      MaskFrame corrected = ledController.getCorrectedFrame(frame);
+      frame.left[0][0] = corrected.left[0][0]; // Keep the call from being optimised away
     }
-    else
+    report(F("led"), F("getCorrectedFrame"), ESP.getCycleCount() - start, heapBefore);
+
+    heapBefore = ESP.getFreeHeap();
+    start = ESP.getCycleCount();
+    for (uint16_t n = 0; n < BENCHMARK_ITERATIONS; n++)
     {
-      // This is the first tap - mark it as pending and start the timer
-      state.lastReleaseTime = 0;
-      state.pendingTap = true;
+      ledController.present(frame);
     }
-  }
+    report(F("led"), F("present"), ESP.getCycleCount() - start, heapBefore);
 
-  void checkHold(ButtonState &state, uint32_t deltaTime)
-  {
-    if (!state.holdTriggered && state.pressTime >= holdThreshold)
+    heapBefore = ESP.getFreeHeap();
+    start = ESP.getCycleCount();
+    for (uint16_t n = 0; n < BENCHMARK_ITERATIONS; n++)
     {
-      triggerActions(state.pin, ButtonEvent::Hold);
-      state.holdTriggered = true;
+      buttonHandler.update(BENCHMARK_TICK_MS);
     }
+    report(F("input"), F("ButtonHandler::update"), ESP.getCycleCount() - start, heapBefore);
+
+    Serial.println(F("# bench done"));
+  }
+
+private:
+  static void report(const __FlashStringHelper *group, const __FlashStringHelper *name, uint32_t cycles, uint32_t heapBefore)
+  {
+    uint32_t cyclesPerIter = cycles / BENCHMARK_ITERATIONS;
+    uint32_t nsPerIter = cyclesPerIter * 1000 / ESP.getCpuFreqMHz();
+    int32_t heapDelta = static_cast<int32_t>(heapBefore) - static_cast<int32_t>(ESP.getFreeHeap());
+
+    Serial.print(F("bench,"));
+    Serial.print(group);
+    Serial.print('/');
+    Serial.print(name);
+    Serial.print(',');
+    Serial.print(cyclesPerIter);
+    Serial.print(',');
+    Serial.print(nsPerIter);
+    Serial.print(',');
+    Serial.print(heapDelta);
+    Serial.println(','); // allocs, host only
   }
 };
 
@@ -1871,15 +4132,40 @@ private:
 #define NEO_PIN D5          // Define pin for right side LEDs
 #define NEO_NUMPIXEL 32     // Number of LEDs per side
 #define NEO_NUMPIXEL_PER 16 // Number of LEDs per side
+#if DUAL_LANE_OUTPUT
+#define NEO_PIN_RIGHT D6 // Right panel data pin, NEO_PIN then drives only the left panel
+static_assert(NEO_PIN < 16 && NEO_PIN_RIGHT < 16, "Dual lane output needs GPIO0-15 pins");
+#endif
+
+#if IMU_MODE
+#define IMU_SDA_PIN D3 // D1/D2 are taken by the buttons
+#define IMU_SCL_PIN D4
+#endif
 
 // Global instances
 const unsigned long DOUBLE_TAP_TIME = 300;               // milliseconds
 const unsigned long HOLD_TIME = 700;                     // milliseconds
 ButtonHandler buttonHandler(DOUBLE_TAP_TIME, HOLD_TIME); // 300ms for double tap, 700ms for hold
+ButtonHandler *actionButtons = &buttonHandler;            // Handler the button actions ask about held buttons
 MaskFrame frame = MaskFrame();
+IndexedFrame indexedFrame = IndexedFrame();
 Core::ModeManager modeManager = Core::ModeManager();
-Core::ExpressionManager expressionManager = Core::ExpressionManager(&frame);
+Core::ExpressionManager expressionManager = Core::ExpressionManager(&frame, &indexedFrame);
+#if DUAL_LANE_OUTPUT
+LedController ledController = LedController(NEO_PIN, NEO_PIN_RIGHT, NEO_NUMPIXEL_PER);
+#else
 LedController ledController = LedController(NEO_PIN, NEO_NUMPIXEL);
+#endif
+Settings settings = Settings(ledController, modeManager, expressionManager);
+HealthMonitor healthMonitor = HealthMonitor(modeManager);
+#if INPUT_TRACE_MODE
+InputTrace inputTrace;
+#endif
+#if IMU_MODE
+HeadMotion headMotion;
+#endif
+Sequencer sequencer;
+MaskFrame transitionFrom = MaskFrame(); // Last frame before a Transition cue, faded out from
 
 // Forward declarations
 void onButton1Tap();
@@ -1890,12 +4176,30 @@ void onButton2Tap();
 void onButton2DoubleTap();
 void onButton2Hold();
 void onButton2Release();
+#if INPUT_TRACE_MODE
+void printTraceEvent(uint8_t buttonPin, ButtonHandler::ButtonEvent event);
+#endif
 
 void setup()
 {
   Serial.begin(9600);
   // Serial.println("System Initializing...");
-  delay(1000); // Give serial time to stabilize
+
+  // Restore the saved state and show the first frame before anything else
+  ledController.begin();
+  ledController.setBrightness(5);
+
+  frame.clear();
+  expressionManager.setExpression(Expressions::Type::Neutral);
+  modeManager.setMode(Core::Mode::ACTIVE);
+  Expressions::getTextScroller().append(F("SCP-1471"));
+  settings.load();
+
+  if (modeManager.isActive())
+  {
+    expressionManager.updateFrame();
+  }
+  presentFrame();
 
   // Initialize button handler with pins
   buttonHandler.begin(BUTTON1_PIN, BUTTON2_PIN, BUTTON3_PIN);
@@ -1910,12 +4214,22 @@ void setup()
   buttonHandler.registerAction(BUTTON2_PIN, ButtonHandler::ButtonEvent::Hold, onButton2Hold);
   buttonHandler.registerAction(BUTTON2_PIN, ButtonHandler::ButtonEvent::Release, onButton2Release);
 
-  ledController.begin();
-  ledController.setBrightness(5);
+#if LATENCY_MODE
+  attachInterrupt(digitalPinToInterrupt(BUTTON1_PIN), onButtonEdge, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(BUTTON2_PIN), onButtonEdge, CHANGE);
+#endif
 
-  frame.clear();
-  expressionManager.setExpression(Expressions::Type::Neutral);
-  modeManager.setMode(Core::Mode::ACTIVE);
+#if IMU_MODE
+  headMotion.begin(IMU_SDA_PIN, IMU_SCL_PIN);
+#endif
+
+#if SEQUENCER_AUTOSTART
+  sequencer.start(SHOWS[0]);
+#endif
+
+#if BENCHMARK_MODE
+  Benchmark::runAll(ledController, buttonHandler);
+#endif
 }
 
 unsigned long lastUpdate = 0;
@@ -1925,6 +4239,27 @@ void loop()
   unsigned long currentTime = millis();
   uint32_t deltaTime = currentTime - lastUpdate; // Time since last update
   lastUpdate = currentTime;
+  healthMonitor.beginFrame();
+
+  // Poll input before rendering so a button action is visible in this frame
+#if LATENCY_MODE
+  uint32_t stateBefore = getVisibleStateSignature();
+#endif
+  buttonHandler.update(deltaTime);
+#if INPUT_TRACE_MODE
+  inputTrace.record(buttonHandler.getRawMask(), deltaTime);
+#endif
+#if LATENCY_MODE
+  if (getVisibleStateSignature() != stateBefore)
+  {
+    latencyProbe.markChange();
+  }
+#endif
+
+  if (modeManager.isActive())
+  {
+    updateSequencer(deltaTime);
+  }
 
   switch (modeManager.getMode())
   {
@@ -1938,14 +4273,26 @@ void loop()
     // In manual mode, expression is controlled by button actions
     break;
   case Core::Mode::ERROR:
-    ledController.present(getErrorFrame());
+    frame = getErrorFrame(static_cast<uint8_t>(healthMonitor.getError()));
     break;
   default:
     expressionManager.setExpression(Expressions::Type::Neutral);
     break;
   }
-  buttonHandler.update(deltaTime);
-  ledController.present(frame);
+  presentFrame();
+#if LATENCY_MODE
+  latencyProbe.markPresented();
+#endif
+#if IMU_MODE
+  updateHeadMotion(deltaTime);
+#endif
+  if (settings.update(deltaTime))
+  {
+    healthMonitor.excuseFrame(); // Sector erase, not a render overrun
+  }
+  healthMonitor.endFrame(deltaTime);
+  handleSerialCommands();
+  logger.drain();
 
   delay(10); // Small delay for stability
 }
@@ -1954,9 +4301,9 @@ void loop()
 // Tap handlers
 void onButton1Tap()
 {
-  Serial.println("Button 1: Tap");
+  LOG_INFO(LogEvent::ButtonTap, 1);
 
-  if (!buttonHandler.isButtonHeld(BUTTON2_PIN))
+  if (!actionButtons->isButtonHeld(BUTTON2_PIN))
   {
     if (wakeUp())
     {
@@ -1966,6 +4313,11 @@ void onButton1Tap()
     switch (modeManager.getMode())
     {
     case Core::Mode::ACTIVE:
+      if (sequencer.isRunning())
+      {
+        sequencer.togglePause();
+        break;
+      }
       expressionManager.nextNormalExpression();
       break;
     default:
@@ -1988,8 +4340,8 @@ void onButton1Tap()
 
 void onButton2Tap()
 {
-  Serial.println("Button 2: Tap");
-  if (!buttonHandler.isButtonHeld(BUTTON1_PIN))
+  LOG_INFO(LogEvent::ButtonTap, 2);
+  if (!actionButtons->isButtonHeld(BUTTON1_PIN))
   {
     switch (modeManager.getMode())
     {
@@ -1998,6 +4350,11 @@ void onButton2Tap()
       {
         return;
       }
+      if (sequencer.isRunning())
+      {
+        sequencer.resync(DOUBLE_TAP_TIME); // Taps are reported once the double tap window closes
+        break;
+      }
       expressionManager.previousNormalExpression();
       break;
     default:
@@ -2008,8 +4365,8 @@ void onButton2Tap()
   {
     switch (modeManager.getMode())
     {
-    case Core::Mode::ACTIVE:
-    case Core::Mode::MANUAL:
+    case Core::Mode::ACTIVE: // MANUAL never runs the scroll
+      showNextMacroMessage();
       break;
     default:
       break;
@@ -2020,9 +4377,14 @@ void onButton2Tap()
 // Double tap handlers
 void onButton1DoubleTap()
 {
-  Serial.println("Button 1: Double Tap");
-  if (!buttonHandler.isButtonHeld(BUTTON2_PIN))
+  LOG_INFO(LogEvent::ButtonDoubleTap, 1);
+  if (!actionButtons->isButtonHeld(BUTTON2_PIN))
   {
+    if (sequencer.isRunning())
+    {
+      sequencer.stop();
+      return;
+    }
     setForQuickExpressionChange();
   }
   else
@@ -2033,8 +4395,8 @@ void onButton1DoubleTap()
 
 void onButton2DoubleTap()
 {
-  Serial.println("Button 2: Double Tap");
-  if (!buttonHandler.isButtonHeld(BUTTON1_PIN))
+  LOG_INFO(LogEvent::ButtonDoubleTap, 2);
+  if (!actionButtons->isButtonHeld(BUTTON1_PIN))
   {
     expressionManager.quickSwitch();
   }
@@ -2047,24 +4409,24 @@ void onButton2DoubleTap()
 // Hold handlers
 void onButton1Hold()
 {
-  Serial.println("Button 1: Hold");
+  LOG_INFO(LogEvent::ButtonHold, 1);
 }
 
 void onButton2Hold()
 {
-  Serial.println("Button 2: Hold");
+  LOG_INFO(LogEvent::ButtonHold, 2);
 }
 
 // Release handlers
 void onButton1Release()
 {
-  Serial.println("Button 1: Release");
+  LOG_INFO(LogEvent::ButtonRelease, 1);
   toggleOnOffMode();
 }
 
 void onButton2Release()
 {
-  Serial.println("Button 2: Release");
+  LOG_INFO(LogEvent::ButtonRelease, 2);
   expressionManager.tagQuickExpression();
 }
 
@@ -2113,9 +4475,33 @@ void toggleOnOffMode()
   }
 }
 
+// Sends whichever framebuffer the current mode drew into to the LEDs
+void presentFrame()
+{
+  bool indexed = (modeManager.isActive() || modeManager.isManual()) && expressionManager.isIndexedFrameActive();
+
+  uint8_t mix;
+  if (modeManager.isActive() && sequencer.getTransitionMix(mix))
+  {
+    MaskFrame blended = frame;
+    if (indexed)
+      indexedFrame.expand(blended);
+    blended.blendFrom(transitionFrom, mix);
+    ledController.present(blended);
+  }
+  else if (indexed)
+  {
+    ledController.present(indexedFrame);
+  }
+  else
+  {
+    ledController.present(frame);
+  }
+}
+
 void cycleBrightness()
 {
-  const uint8_t BRIGHTNESS_LEVELS[] = {1, 5, 10, 20, 40, 80, 160, 255};
+  static const uint8_t BRIGHTNESS_LEVELS[] PROGMEM = {1, 5, 10, 20, 40, 80, 160, 255};
   const uint8_t NUM_LEVELS = sizeof(BRIGHTNESS_LEVELS) / sizeof(BRIGHTNESS_LEVELS[0]);
 
   uint8_t currentBrightness = ledController.getBrightness();
@@ -2123,7 +4509,7 @@ void cycleBrightness()
 
   for (uint8_t i = 0; i < NUM_LEVELS; i++)
   {
-    if (currentBrightness < BRIGHTNESS_LEVELS[i])
+    if (currentBrightness < pgm_read_byte(&BRIGHTNESS_LEVELS[i]))
     {
       nextIndex = i;
       break;
@@ -2131,10 +4517,318 @@ void cycleBrightness()
     nextIndex = (i + 1) % NUM_LEVELS;
   }
 
-  ledController.setBrightness(BRIGHTNESS_LEVELS[nextIndex]);
+  ledController.setBrightness(pgm_read_byte(&BRIGHTNESS_LEVELS[nextIndex]));
 }
 
 void setForQuickExpressionChange()
 {
   expressionManager.setForChange(2000, 15000);
 }
+
+// Advances the running show and applies its due cues
+void updateSequencer(uint32_t deltaTime)
+{
+  sequencer.update(deltaTime);
+
+  Cue cue;
+  while (sequencer.poll(cue))
+  {
+    switch (static_cast<CueOp>(cue.op))
+    {
+    case CueOp::Expression:
+      expressionManager.setExpression(static_cast<Expressions::Type>(cue.arg0));
+      break;
+    case CueOp::Transition:
+      // frame and indexedFrame still hold what was presented last
+      if (expressionManager.isIndexedFrameActive())
+        indexedFrame.expand(transitionFrom);
+      else
+        transitionFrom = frame;
+      sequencer.startTransition(cue.arg1);
+      expressionManager.setExpression(static_cast<Expressions::Type>(cue.arg0));
+      break;
+    case CueOp::Brightness:
+      sequencer.startRamp(ledController.getOutputBrightness(), cue.arg0, cue.arg1);
+      break;
+    default:
+      break;
+    }
+  }
+
+  uint8_t level;
+  if (sequencer.getRampLevel(level))
+  {
+    ledController.setShowBrightness(level);
+  }
+  else if (sequencer.isIdle())
+  {
+    ledController.clearShowBrightness();
+  }
+}
+
+// Scrolls the current message once, then returns to the previous expression.
+// Only ACTIVE animates expressions, elsewhere the message is kept but not shown.
+void showMessage()
+{
+  if (!modeManager.isActive())
+    return;
+
+  TextScroller &scroller = Expressions::getTextScroller();
+  scroller.restart();
+  expressionManager.react(Expressions::Type::Text, scroller.getDuration());
+}
+
+// Steps through a status readout and a few fixed lines
+void showNextMacroMessage()
+{
+  static uint8_t macroIndex = 0;
+  TextScroller &scroller = Expressions::getTextScroller();
+  scroller.clear();
+
+  switch (macroIndex)
+  {
+  case 0:
+    scroller.append(F("BRI "));
+    scroller.appendNumber(ledController.getBrightness());
+    scroller.append(' ');
+    scroller.append(Expressions::getName(expressionManager.getCurrentExpression()));
+    break;
+  case 1:
+    scroller.append(F("HELLO!"));
+    break;
+  default:
+    scroller.append(F("SCP-1471"));
+    break;
+  }
+
+  macroIndex = (macroIndex + 1) % 3;
+  showMessage();
+}
+
+#if IMU_MODE
+// Runs after present so the I2C reads never hold up the LEDs
+void updateHeadMotion(uint32_t deltaTime)
+{
+  headMotion.update(deltaTime);
+  Expressions::setGaze(headMotion.getGazeDirection());
+
+  if (headMotion.takeJerk() && modeManager.isActive() &&
+      expressionManager.getCurrentExpression() != Expressions::Type::Surprised)
+  {
+    expressionManager.react(Expressions::Type::Surprised, IMU_REACTION_MS);
+  }
+}
+#endif
+
+#if LATENCY_MODE
+// Anything that changes what the LEDs show in response to a button
+uint32_t getVisibleStateSignature()
+{
+  return static_cast<uint32_t>(expressionManager.getCurrentExpression()) |
+         (static_cast<uint32_t>(modeManager.getMode()) << 8) |
+         (static_cast<uint32_t>(ledController.getBrightness()) << 16);
+}
+#endif
+
+#if INPUT_TRACE_MODE
+void printTraceEvent(uint8_t buttonPin, ButtonHandler::ButtonEvent event)
+{
+  Serial.print(F("replay,"));
+  Serial.print(inputTrace.getReplayTime());
+  Serial.print(',');
+  Serial.print(buttonPin);
+  Serial.print(',');
+  Serial.println(Logger::getEventName(static_cast<uint8_t>(event)));
+}
+
+// Replays run on their own button handler and park the live state here, in
+// static storage instead of on the 4 KB cont stack
+ButtonHandler replayButtons(DOUBLE_TAP_TIME, HOLD_TIME);
+Core::ModeManager replaySavedMode;
+Core::ExpressionManager replaySavedExpression(&frame, &indexedFrame);
+Sequencer replaySavedSequencer;
+TextScroller replaySavedText;
+
+// Replays the trace through a copy of the button handler and the actions from
+// a fixed start state (ACTIVE, Neutral, brightness 5, no show), reports where it
+// left the mask, then puts the live state back. The live handler keeps its
+// gesture state, and settings and logging are paused meanwhile.
+void replayInputTrace()
+{
+  replaySavedMode = modeManager;
+  replaySavedExpression = expressionManager;
+  replaySavedSequencer = sequencer;
+  replaySavedText = Expressions::getTextScroller();
+  uint8_t liveBrightness = ledController.getBrightness();
+  settings.setPaused(true);
+  logger.setMuted(true);
+
+  modeManager = Core::ModeManager();
+  modeManager.setMode(Core::Mode::ACTIVE);
+  expressionManager = Core::ExpressionManager(&frame, &indexedFrame);
+  expressionManager.setExpression(Expressions::Type::Neutral);
+  sequencer = Sequencer();
+  ledController.setBrightness(5);
+
+  Serial.println(F("# replay virtual_ms,pin,event"));
+  replayButtons = buttonHandler; // Same pins and actions
+  replayButtons.setEventObserver(printTraceEvent);
+  actionButtons = &replayButtons;
+  uint32_t duration = inputTrace.replay(replayButtons);
+  actionButtons = &buttonHandler;
+
+  Serial.print(F("# replay done runs="));
+  Serial.print(inputTrace.getLength());
+  Serial.print(F(" virtual_ms="));
+  Serial.print(duration);
+  Serial.print(F(" mode="));
+  Serial.print(static_cast<uint8_t>(modeManager.getMode()));
+  Serial.print(F(" expression="));
+  Serial.print(Expressions::getName(expressionManager.getCurrentExpression()));
+  Serial.print(F(" quick="));
+  Serial.print(Expressions::getName(expressionManager.getQuickExpression()));
+  Serial.print(F(" brightness="));
+  Serial.println(ledController.getBrightness());
+
+  modeManager = replaySavedMode;
+  expressionManager = replaySavedExpression;
+  sequencer = replaySavedSequencer;
+  Expressions::getTextScroller() = replaySavedText;
+  ledController.setBrightness(liveBrightness);
+  logger.setMuted(false);
+  settings.setPaused(false);
+}
+#endif
+
+// Single-character commands over serial:
+//   h - log health statistics
+//   m - print head motion state (IMU_MODE only)
+//   l - print button-to-photon latency (LATENCY_MODE only)
+//   r, s, d, p - record, stop, dump and replay input traces (INPUT_TRACE_MODE only)
+//   q - start/stop the show, z - pause/resume it, y - resync it to the next cue
+// Commands with a payload take the rest of the line:
+//   u<hex> - upload an input trace (INPUT_TRACE_MODE only)
+//   t<text> - scroll a message across both eyes
+//   k<ms> - seek the running show to ms
+void handleSerialCommands()
+{
+  static char lineCommand = 0;      // Command whose payload is still arriving
+  static uint32_t serialNumber = 0; // Decimal payload of that command
+
+  while (Serial.available() > 0)
+  {
+    char c = Serial.read();
+
+    if (lineCommand != 0)
+    {
+      if (c == '\n' || c == '\r')
+      {
+        finishSerialPayload(lineCommand, serialNumber);
+        lineCommand = 0;
+      }
+      else
+      {
+        handleSerialPayload(lineCommand, c, serialNumber);
+      }
+      continue;
+    }
+
+    switch (c)
+    {
+    case 'h':
+      healthMonitor.logStats();
+      break;
+#if LATENCY_MODE
+    case 'l':
+      latencyProbe.printStats();
+      break;
+#endif
+#if IMU_MODE
+    case 'm':
+      headMotion.printStats();
+      break;
+#endif
+#if INPUT_TRACE_MODE
+    case 'r':
+      inputTrace.start();
+      break;
+    case 's':
+      inputTrace.stop();
+      break;
+    case 'd':
+      inputTrace.dump();
+      break;
+    case 'p':
+      replayInputTrace();
+      break;
+    case 'u':
+      inputTrace.beginUpload();
+      lineCommand = c;
+      break;
+#endif
+    case 't':
+      Expressions::getTextScroller().clear();
+      lineCommand = c;
+      break;
+    case 'q':
+      if (sequencer.isRunning())
+        sequencer.stop();
+      else
+        sequencer.start(SHOWS[0]);
+      break;
+    case 'z':
+      sequencer.togglePause();
+      break;
+    case 'y':
+      sequencer.resync();
+      break;
+    case 'k':
+      serialNumber = 0;
+      lineCommand = c;
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+void handleSerialPayload(char command, char c, uint32_t &number)
+{
+  switch (command)
+  {
+#if INPUT_TRACE_MODE
+  case 'u':
+    inputTrace.uploadHexChar(c);
+    break;
+#endif
+  case 't':
+    Expressions::getTextScroller().append(c);
+    break;
+  case 'k':
+    if (c >= '0' && c <= '9')
+      number = number * 10 + (c - '0');
+    break;
+  default:
+    break;
+  }
+}
+
+void finishSerialPayload(char command, uint32_t number)
+{
+  switch (command)
+  {
+#if INPUT_TRACE_MODE
+  case 'u':
+    inputTrace.endUpload();
+    break;
+#endif
+  case 't':
+    showMessage();
+    break;
+  case 'k':
+    sequencer.seek(number);
+    break;
+  default:
+    break;
+  }
+}